@@ -0,0 +1,196 @@
+#include "callee-registry.h"
+#include "utils.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace llvm {
+
+static cl::opt<std::string> CalleeRegistryFile("callee-registry", cl::desc("File the callee classification and hardcode rules are loaded from"), cl::init("callees.txt"));
+
+enum RuleGroup { GROUP_VECTOR_OP, GROUP_STD, GROUP_DYNAMIC_CAST, GROUP_API };
+
+CalleeRegistry::FuncNames::FuncNames(const Function *F) {
+    mangled = F->getName().str();
+    demangled = demangle(mangled.c_str());
+    base = get_func_name(mangled.c_str());
+}
+
+bool CalleeRegistry::matches(const FuncNames &names, const std::string &field, const std::string &pattern) {
+    if (field == "mangled")
+        return names.mangled.find(pattern) != std::string::npos;
+    if (field == "demangled")
+        return names.demangled.find(pattern) != std::string::npos;
+    if (field == "base")
+        return names.base.find(pattern) != std::string::npos;
+    if (field == "exact")
+        return names.demangled == pattern;
+    return false;
+}
+
+static bool isFuncField(const std::string &field) {
+    return field == "mangled" || field == "demangled" || field == "base" || field == "exact";
+}
+
+static bool isValueType(const std::string &type) {
+    return type == "bool" || type == "int" || type == "real";
+}
+
+bool CalleeRegistry::load(const std::string &path) {
+    std::ifstream infile(path.c_str());
+    if (!infile.is_open())
+        return false;
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(infile, line)) {
+        lineNo++;
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind) || kind[0] == '#')
+            continue;
+
+        HardcodeRule H;
+        Rule R;
+        R.negated = false;
+        bool valid = true;
+        if (kind == "hardcode") {
+            valid = (bool)(fields >> H.caller >> H.field >> H.type >> H.value) && isFuncField(H.field) && isValueType(H.type);
+        } else if (kind == "hardcode-global") {
+            valid = (bool)(fields >> H.type >> H.value) && isValueType(H.type);
+        } else {
+            valid = (bool)(fields >> R.field) && (kind == "vector-type" ? R.field == "type" : isFuncField(R.field));
+        }
+        std::string pattern;
+        std::getline(fields >> std::ws, pattern);
+        if (!valid || pattern.empty()) {
+            errs() << path << ":" << lineNo << ": malformed callee rule: " << line << "\n";
+            continue;
+        }
+
+        if (kind == "hardcode") {
+            H.callee = pattern;
+            hardcodes.push_back(H);
+            continue;
+        }
+        if (kind == "hardcode-global") {
+            H.callee = pattern;
+            globalHardcodes.push_back(H);
+            continue;
+        }
+        if (kind == "vector-type") {
+            vectorTypes.push_back(pattern);
+            continue;
+        }
+        R.pattern = pattern;
+        if (kind == "vector-empty") {
+            R.cls = CALLEE_VECTOR_EMPTY;
+            R.group = GROUP_VECTOR_OP;
+        } else if (kind == "vector-size") {
+            R.cls = CALLEE_VECTOR_SIZE;
+            R.group = GROUP_VECTOR_OP;
+        } else if (kind == "vector-not-equal") {
+            R.cls = CALLEE_VECTOR_NOT_EQUAL;
+            R.group = GROUP_VECTOR_OP;
+        } else if (kind == "vector-push") {
+            R.cls = CALLEE_VECTOR_PUSH;
+            R.group = GROUP_VECTOR_OP;
+        } else if (kind == "std-helper" || kind == "not-std-helper") {
+            R.cls = CALLEE_STD_HELPER;
+            R.group = GROUP_STD;
+            R.negated = kind == "not-std-helper";
+        } else if (kind == "dynamic-cast") {
+            R.cls = CALLEE_DYNAMIC_CAST;
+            R.group = GROUP_DYNAMIC_CAST;
+        } else if (kind == "api") {
+            R.cls = CALLEE_API;
+            R.group = GROUP_API;
+        } else {
+            errs() << path << ":" << lineNo << ": unknown callee rule " << kind << "\n";
+            continue;
+        }
+        rules.push_back(R);
+    }
+    infile.close();
+    classes.clear();
+    vectorTypeCache.clear();
+    hardcodeCache.clear();
+    return true;
+}
+
+unsigned CalleeRegistry::getClass(const Function *F) {
+    if (F == nullptr)
+        return CALLEE_NONE;
+    auto it = classes.find(F);
+    if (it != classes.end())
+        return it->second;
+
+    FuncNames names(F);
+    unsigned cls = CALLEE_NONE;
+    unsigned decided = 0;
+    for (const Rule &R : rules) {
+        if (decided & (1u << R.group))
+            continue;
+        if (!matches(names, R.field, R.pattern))
+            continue;
+        decided |= 1u << R.group;
+        if (!R.negated)
+            cls |= R.cls;
+    }
+    classes[F] = cls;
+    return cls;
+}
+
+bool CalleeRegistry::isVectorType(Type *T) {
+    auto it = vectorTypeCache.find(T);
+    if (it != vectorTypeCache.end())
+        return it->second;
+
+    std::string local_name;
+    raw_string_ostream rso(local_name);
+    T->print(rso);
+    std::string typeName = rso.str();
+    bool result = false;
+    for (const std::string &pattern : vectorTypes) {
+        if (typeName.find(pattern) != std::string::npos) {
+            result = true;
+            break;
+        }
+    }
+    vectorTypeCache[T] = result;
+    return result;
+}
+
+const HardcodeRule *CalleeRegistry::getHardcode(const Function *caller, const Function *callee) {
+    if (caller == nullptr || callee == nullptr || hardcodes.empty())
+        return nullptr;
+    auto key = std::make_pair(caller, callee);
+    auto it = hardcodeCache.find(key);
+    if (it != hardcodeCache.end())
+        return it->second < 0 ? nullptr : &hardcodes[it->second];
+
+    std::string callerName = demangle(caller->getName().str().c_str());
+    FuncNames names(callee);
+    int found = -1;
+    for (unsigned i = 0; i < hardcodes.size(); i++) {
+        if (callerName.find(hardcodes[i].caller) != std::string::npos && matches(names, hardcodes[i].field, hardcodes[i].callee))
+            found = i;
+    }
+    hardcodeCache[key] = found;
+    return found < 0 ? nullptr : &hardcodes[found];
+}
+
+CalleeRegistry &getCalleeRegistry() {
+    static CalleeRegistry registry;
+    static bool loaded = false;
+    if (!loaded) {
+        loaded = true;
+        if (!registry.load(CalleeRegistryFile))
+            errs() << "Failed to read callee rules from " << CalleeRegistryFile << "\n";
+    }
+    return registry;
+}
+
+}  // namespace llvm
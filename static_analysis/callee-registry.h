@@ -0,0 +1,99 @@
+#ifndef __CALLEE_REGISTRY_H__
+#define __CALLEE_REGISTRY_H__
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Value.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/** Classes of a callee, as flags: at most one vector op, plus any of the others */
+enum CalleeClass : unsigned {
+    CALLEE_NONE = 0,
+    // operations on a std::vector / protobuf repeated field
+    CALLEE_VECTOR_EMPTY = 1 << 0,
+    CALLEE_VECTOR_SIZE = 1 << 1,
+    CALLEE_VECTOR_NOT_EQUAL = 1 << 2,
+    CALLEE_VECTOR_PUSH = 1 << 3,
+    CALLEE_DYNAMIC_CAST = 1 << 4,
+    // library helpers that are not analyzed (their result is a fresh variable)
+    CALLEE_STD_HELPER = 1 << 5,
+    // API functions whose calls are named after their arguments
+    CALLEE_API = 1 << 6,
+};
+
+/** A value forced on the calls to some callee made by some caller, or on a global (named by callee) */
+struct HardcodeRule {
+    std::string caller;
+    std::string field;
+    std::string callee;
+    // "bool", "int" or "real"
+    std::string type;
+    std::string value;
+};
+
+/** Classification of callees and types by name, read from a data file (see callees.txt for the format).
+ * Each Function / Type is matched against the rules once and the result is cached.
+ * Not thread-safe: only used from serial parts of the passes. */
+class CalleeRegistry {
+   public:
+    bool load(const std::string &path);
+
+    /** CalleeClass flags of F */
+    unsigned getClass(const Function *F);
+    bool is(const Function *F, CalleeClass cls) {
+        return (getClass(F) & cls) != 0;
+    }
+
+    /** Whether values of T are std::vector / protobuf repeated fields */
+    bool isVectorType(Type *T);
+    bool isVectorType(Value *V) {
+        return V != nullptr && isVectorType(V->getType());
+    }
+
+    /** Last hardcode rule matching a call to callee made in caller, or null */
+    const HardcodeRule *getHardcode(const Function *caller, const Function *callee);
+    /** Hardcode rules of globals */
+    const std::vector<HardcodeRule> &getGlobalHardcodes() const {
+        return globalHardcodes;
+    }
+
+   private:
+    struct Rule {
+        unsigned cls;
+        // rules of one group decide together: the first matching one wins
+        unsigned group;
+        bool negated;
+        std::string field;
+        std::string pattern;
+    };
+
+    std::vector<Rule> rules;
+    std::vector<std::string> vectorTypes;
+    std::vector<HardcodeRule> hardcodes;
+    std::vector<HardcodeRule> globalHardcodes;
+
+    DenseMap<const Function *, unsigned> classes;
+    DenseMap<Type *, bool> vectorTypeCache;
+    DenseMap<std::pair<const Function *, const Function *>, int> hardcodeCache;
+
+    /** Names of a function in the forms rules can match */
+    struct FuncNames {
+        std::string mangled;
+        std::string demangled;
+        std::string base;
+        explicit FuncNames(const Function *F);
+    };
+    static bool matches(const FuncNames &names, const std::string &field, const std::string &pattern);
+};
+
+/** The registry, loaded from -callee-registry (default callees.txt) on first use */
+CalleeRegistry &getCalleeRegistry();
+
+}  // namespace llvm
+
+#endif  // __CALLEE_REGISTRY_H__
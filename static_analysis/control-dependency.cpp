@@ -1,4 +1,7 @@
 #include "control-dependency.h"
+#include "callee-registry.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
 #include <stack>
 
 namespace llvm {
@@ -6,6 +9,8 @@ namespace llvm {
 char ControlDependency::ID = 1;
 static RegisterPass<ControlDependency> A("control-dependency", "control dependency analysis on given function", false, true);
 
+static cl::opt<unsigned> CDThreads("cd-threads", cl::desc("Number of threads slicing functions in control-dependency (0 uses one per hardware thread)"), cl::init(0));
+
 bool ControlDependency::doInitialization(Module &M) {
     //record the source function name
     std::ifstream configFile("config.tmp");
@@ -40,6 +45,9 @@ bool ControlDependency::doInitialization(Module &M) {
     }
 
     for (Function &F : M) {
+        // unused declarations cannot be targets, sinks or sources (with traffic-rule-driver, most functions are)
+        if (F.isDeclaration() && F.use_empty())
+            continue;
         std::string funcName = demangle(F.getName().str().c_str());
         if (TargetFuncs.find(funcName) != TargetFuncs.end()) {
             TargetFuncPtrs.insert(&F);
@@ -62,6 +70,20 @@ bool ControlDependency::doFinalization(Module &M) {
     return false;
 }
 
+void ControlDependency::releaseMemory() {
+    FunctionData.clear();
+    SinkBBIndex.clear();
+    MCFG.clear();
+    MNodeIndex.clear();
+    CallDAG.clear();
+    InterCalls.clear();
+    DefUses.clear();
+    CDGs.clear();
+    InstrIds.clear();
+    MNodeArenas.clear();
+    SinkBBArena.DestroyAll();
+}
+
 bool ControlDependency::runOnModule(Module &M) {
     // for (Function &F : M) {
     //     errs() << demangle(F.getName().str().c_str()) << "\n";
@@ -70,195 +92,181 @@ bool ControlDependency::runOnModule(Module &M) {
     CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
     buildCallGraph(&M, &CG);
     errs() << "Number of functions ready for CD analysis: " << FunctionData.size() << "\n";
+
+    // Analyses are fetched up front: the pass manager cannot be queried from the slicing threads
+    RD = &getAnalysis<ReachingDefinitions>();
+    std::vector<Function *> funcs;
     for (Function &F : M) {
-        runOnFunction(F);
+        if (F.isDeclaration() || FunctionData.find(&F) == FunctionData.end())
+            continue;
+        getControlDependenceGraph(F);
+        getInstructionIds(F);
+        funcs.push_back(&F);
     }
+    std::vector<FunctionSlice> slices(funcs.size());
+    parallelForEach(CDThreads, funcs.size(), [&](size_t i) {
+        sliceFunction(*funcs[i], slices[i]);
+    });
+    // Merge in module order to keep the output independent of the thread count
+    for (size_t i = 0; i < slices.size(); i++)
+        mergeSlice(slices[i]);
+
     errs() << "Eval Instr " << instr_cnt << " / " << instr_total << "\n";
     errs() << "Eval BB " << bb_cnt << " / " << bb_total << "\n";
     return false;
 }
 
-bool ControlDependency::runOnFunction(Function &F) {
-    std::string funcName = demangle(F.getName().str().c_str());
-
-    // F is a function declaration without function body
-    if (F.isDeclaration())
-        return false;
-
-    // F is out of our analysis scope
-    if (FunctionData.find(&F) == FunctionData.end())
-        return false;
-
-    errs() << "Start control-dependency on " << funcName << "\n";
+void ControlDependency::mergeSlice(FunctionSlice &slice) {
+    errs() << slice.log;
+    MCFG[slice.F] = std::move(slice.nodes);
+    MNodeIndex[slice.F] = std::move(slice.index);
+    MNodeArenas.push_back(std::move(slice.arena));
+    DefUses[slice.F] = std::move(slice.defUses);
+    instr_cnt += slice.instr_cnt;
+    instr_total += slice.instr_total;
+    bb_cnt += slice.bb_cnt;
+    bb_total += slice.bb_total;
+}
 
-    // init MCFG
-    MCFG[&F] = std::vector<MNode *>();
+void ControlDependency::sliceFunction(Function &F, FunctionSlice &slice) {
+    std::string funcName = demangle(F.getName().str().c_str());
+    raw_string_ostream log(slice.log);
+    slice.F = &F;
 
-    // Loop Headers
-    std::set<BasicBlock *> loopHeaders;
-    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+    log << "Start control-dependency on " << funcName << "\n";
 
     // CDs
-    std::map<BasicBlock *, std::vector<CDNode>> CDMap;
-    PostDominatorTree &PDT = getAnalysis<PostDominatorTreeWrapperPass>(F).getPostDomTree();
+    const ControlDependenceGraph &CDG = *CDGs.find(&F)->second;
+    const std::vector<SinkBBNode *> &sinkBBs = FunctionData.find(&F)->second;
+    static const std::set<Instruction *> noVectorDeps;
+    auto vectorDepsIt = VectorDeps.find(&F);
+    const std::set<Instruction *> &vectorDeps = vectorDepsIt == VectorDeps.end() ? noVectorDeps : vectorDepsIt->second;
 
-    // control dependency analysis
-    for (Function::iterator b = F.begin(); b != F.end(); b++) {
-        BasicBlock *A = &(*b);
-        for (succ_iterator succ = succ_begin(A), end = succ_end(A); succ != end; ++succ) {
-            BasicBlock *B = *succ;
-            if (!(A && B))
-                continue;
-            if (A == B || !PDT.dominates(B, A)) {
-                BasicBlock *lub = PDT[A]->getIDom()->getBlock();
-                BasicBlock *tmp = B;
-                while (tmp != lub) {
-                    CDNode curNode(A, B, getEdgeType(A, B));
-                    CDMap[tmp].push_back(curNode);
-                    tmp = PDT[tmp]->getIDom()->getBlock();
-                }
-            }
-        }
-        if (LI.isLoopHeader(A)) {
-            loopHeaders.insert(A);
-        }
-    }
     // select minimal required CDNodes
+    // Each block and each operand slot is queued at most once (a popped block / value is never seen again)
+    const InstructionIds &ids = *InstrIds.find(&F)->second;
     std::stack<BasicBlock *> stackBB;
-    std::stack<std::pair<Instruction *, Value *>> stackVal;
-    std::set<BasicBlock *> finishedBB;
-    std::set<std::pair<Instruction *, Value *>> finishedVal;
+    std::stack<std::pair<Instruction *, unsigned>> stackVal;
+    BitVector queuedBB(CDG.blockIds.size());
+    BitVector queuedVal(ids.getNumOperands());
     std::set<BasicBlock *> CDFrom;
     std::set<BasicBlock *> CDTo;
+    auto pushBB = [&](BasicBlock *BB) {
+        unsigned id = CDG.blockIds.find(BB)->second;
+        if (!queuedBB.test(id)) {
+            queuedBB.set(id);
+            stackBB.push(BB);
+        }
+    };
+    auto pushVal = [&](Instruction *I, unsigned opNo) {
+        unsigned id = ids.getOperandId(I, opNo);
+        if (!queuedVal.test(id)) {
+            queuedVal.set(id);
+            stackVal.push(std::make_pair(I, opNo));
+        }
+    };
     // put vector::push_back / emplace_back into the stack
-    for (Instruction *I : VectorDeps[&F]) {
-        stackBB.push(I->getParent());
-        MNode *mnode = new MNode(I->getParent());
+    for (Instruction *I : vectorDeps) {
+        pushBB(I->getParent());
+        MNode *mnode = slice.newMNode(I->getParent(), &ids);
         mnode->addInstr(I);
-        MCFG[&F].push_back(mnode);
+        slice.addMNode(mnode);
     }
     // put sinkBBs in the stack
-    for (SinkBBNode *sinkBB : FunctionData[&F]) {
-        stackBB.push(sinkBB->BB);
-        MNode *mnode = new MNode(sinkBB->BB);
+    for (SinkBBNode *sinkBB : sinkBBs) {
+        pushBB(sinkBB->BB);
+        MNode *mnode = slice.newMNode(sinkBB->BB, &ids);
         mnode->addInstr(sinkBB->I);
-        MCFG[&F].push_back(mnode);
+        slice.addMNode(mnode);
     }
     // start analysis
     while (!stackBB.empty()) {
         BasicBlock *BB = stackBB.top();
         stackBB.pop();
-        if (finishedBB.find(BB) != finishedBB.end()) {
-            continue;
-        }
-        
+
         // add sink Instruction to value analysis
         SinkBBNode *snode = getSinkBBNode(&F, BB);
         if (snode) {
             Instruction *I = snode->I;
-            for (auto op = I->op_begin(); op != I->op_end(); op++) {
-                auto val = std::make_pair(I, dyn_cast<Value>(*op));
-                if (finishedVal.find(val) == finishedVal.end()) {
-                    stackVal.push(val);
-                }
+            for (unsigned op = 0; op < I->getNumOperands(); op++) {
+                pushVal(I, op);
             }
         }
 
         // add vector push_back Instruction to value analysis
-        if (VectorDeps[&F].find(BB->getTerminator()) != VectorDeps[&F].end()) {
+        if (vectorDeps.find(BB->getTerminator()) != vectorDeps.end()) {
             Instruction *I = BB->getTerminator();
-            for (auto op = I->op_begin(); op != I->op_end(); op++) {
-                if (!isa<Instruction>(*op)) continue;  
-                auto val = std::make_pair(I, dyn_cast<Value>(*op));
-                if (finishedVal.find(val) == finishedVal.end()) {
-                    stackVal.push(val);
-                }
+            for (unsigned op = 0; op < I->getNumOperands(); op++) {
+                if (!isa<Instruction>(I->getOperand(op))) continue;
+                pushVal(I, op);
             }
         }
 
         // push CDs into stack if any CD is not been analyzed before
         // errs() << "CD of " << BB->getName() << ":";
-        // for (CDNode cnode : CDMap[BB]) {
-        //     errs() << " " << cnode.from->getName();
+        // for (unsigned edge : CDG.getDependences(BB)) {
+        //     errs() << " " << CDG.edges[edge].from->getName();
         // }
         // errs() << "\n";
-        for (CDNode cnode : CDMap[BB]) {
+        for (unsigned edge : CDG.getDependences(BB)) {
+            const CDNode &cnode = CDG.edges[edge];
             // update MCFG
-            MNode *mnode = getMNode(&F, cnode.from);
+            MNode *mnode = slice.getMNode(cnode.from);
             if (!mnode) {
-                mnode = new MNode(cnode.from);
-                MCFG[&F].push_back(mnode);
+                mnode = slice.newMNode(cnode.from, &ids);
+                slice.addMNode(mnode);
             }
 
             // update edges
             mnode->addEdges(cnode.E);
             CDFrom.insert(cnode.from);
             CDTo.insert(cnode.to);
-            stackBB.push(cnode.from);
+            pushBB(cnode.from);
 
             // extract branch operands
             Instruction *I = mnode->BB->getTerminator();
             // do not add branch instruction to instrs list
             // mnode->addInstr(I);
             if (isa<CallBase>(I)) continue;
-            for (auto op = I->op_begin(); op != I->op_end(); op++) {
-                if (!isa<Instruction>(*op)) continue;
-                auto val = std::make_pair(I, dyn_cast<Value>(*op));
-                if (finishedVal.find(val) == finishedVal.end()) {
-                    stackVal.push(val);
-                }
+            for (unsigned op = 0; op < I->getNumOperands(); op++) {
+                if (!isa<Instruction>(I->getOperand(op))) continue;
+                pushVal(I, op);
             }
         }
         // trace variable values
         while (!stackVal.empty()) {
-            auto val = stackVal.top();
+            Instruction *user = stackVal.top().first;
+            Value *used = user->getOperand(stackVal.top().second);
             stackVal.pop();
-            std::set<Instruction *> defs = getDefinitions(&F, val.first, val.second);
+            const std::set<Instruction *> &defs = lookupDefinitions(&F, slice.defUses, user, used);
             for (Instruction *def : defs) {
                 BasicBlock *defParent = def->getParent();
-                // update stack
-                // if (finishedBB.find(defParent) == finishedBB.end()) {
                 // update MCFG
-                MNode *mnode = getMNode(&F, defParent);
+                MNode *mnode = slice.getMNode(defParent);
                 if (!mnode) {
-                    mnode = new MNode(defParent);
-                    MCFG[&F].push_back(mnode);
+                    mnode = slice.newMNode(defParent, &ids);
+                    slice.addMNode(mnode);
                 }
                 mnode->addInstr(def);
-                mnode->addDU(def, val.first, val.second);
-                MNode *useNode = getMNode(&F, val.first->getParent());
+                mnode->addDU(def, user, used);
+                MNode *useNode = slice.getMNode(user->getParent());
                 if (useNode) {
-                    useNode->addUD(val.first, val.second, def);
+                    useNode->addUD(user, used, def);
                 }
                 // require further CD analysis
-                stackBB.push(defParent);
-                for (auto op = def->op_begin(); op != def->op_end(); op++) {
-                    // if(!isa<Instruction>(op) continue;
-                    auto new_val = std::make_pair(def, dyn_cast<Value>(*op));
-                    if (finishedVal.find(new_val) == finishedVal.end()) {
-                        stackVal.push(new_val);
-                    }
+                pushBB(defParent);
+                for (unsigned op = 0; op < def->getNumOperands(); op++) {
+                    pushVal(def, op);
                 }
             }
-
-            // processing a value finished
-            if (finishedVal.find(val) == finishedVal.end()) {
-                // errs() << "processed value " << val->getName() << "\n";
-                finishedVal.insert(val);
-            }
-        }
-        // processing a BB finished
-        if (finishedBB.find(BB) == finishedBB.end()) {
-            // errs() << "processed BB " << BB->getName() << "\n";
-            finishedBB.insert(BB);
         }
     }
 
     // remove abundant edge restrictions
     for (BasicBlock *from : CDFrom) {
         for (BasicBlock *to : CDTo) {
-            if (PDT.dominates(from, to)) {
-                MNode *mnode = getMNode(&F, from);
+            if (CDG.postDominates(from, to)) {
+                MNode *mnode = slice.getMNode(from);
                 if (mnode) {
                     mnode->edges.clear();
                 }
@@ -267,8 +275,17 @@ bool ControlDependency::runOnFunction(Function &F) {
         }
     }
 
+    // definitions TrafficRuleInfo looks up to name GEPs and calls
+    for (MNode *node : slice.nodes) {
+        for (Instruction *I : node->instrs) {
+            if ((isa<GetElementPtrInst>(I) || isa<CallBase>(I)) && I->getNumOperands() > 0) {
+                lookupDefinitions(&F, slice.defUses, I, I->getOperand(0));
+            }
+        }
+    }
+
     int instrs = 0;
-    for (MNode *BB : MCFG[&F]) {
+    for (MNode *BB : slice.nodes) {
         instrs += BB->instrs.size();
     }
     int total_instrs = 0;
@@ -277,13 +294,12 @@ bool ControlDependency::runOnFunction(Function &F) {
     }
 
     // errs() << "Finish control-dependency on " << funcName << " with " << instrs << "/" << total_instrs << " selected Instrs\n";
-    // errs() << "Finish control-dependency on " << funcName << " with " << MCFG[&F].size() << "/" << F.getBasicBlockList().size() << " selected BBs\n";
-    instr_cnt += instrs;
-    instr_total += total_instrs;
-    bb_cnt += MCFG[&F].size();
-    bb_total += F.getBasicBlockList().size();
-    
-    return false;
+    // errs() << "Finish control-dependency on " << funcName << " with " << slice.nodes.size() << "/" << F.getBasicBlockList().size() << " selected BBs\n";
+    slice.instr_cnt = instrs;
+    slice.instr_total = total_instrs;
+    slice.bb_cnt = slice.nodes.size();
+    slice.bb_total = F.getBasicBlockList().size();
+    log.flush();
 }
 
 void ControlDependency::initAlias(Module &M) {
@@ -291,21 +307,35 @@ void ControlDependency::initAlias(Module &M) {
         if (TargetFuncPtrs.find(&F) == TargetFuncPtrs.end()) {
             continue;
         }
+        AliasClasses &classes = Alias[&F];
         for (BasicBlock &BB : F) {
             for (Instruction &I : BB) {
                 if (I.getOpcode() == Instruction::GetElementPtr) {
-                    Value *op = I.getOperand(0);
-                    Alias[op].insert(&I);
+                    classes.addDerived(I.getOperand(0), &I);
+                }
+                if (I.getOpcode() == Instruction::BitCast || I.getOpcode() == Instruction::AddrSpaceCast) {
+                    if (I.getType()->isPointerTy()) {
+                        classes.unite(I.getOperand(0), &I);
+                    }
                 }
                 if (I.getOpcode() == Instruction::Store) {
-                    Alias[I.getOperand(1)] = Alias[I.getOperand(0)];
-                } 
+                    if (I.getOperand(0)->getType()->isPointerTy()) {
+                        classes.uniteContent(I.getOperand(1), I.getOperand(0));
+                    }
+                }
+                if (I.getOpcode() == Instruction::Load) {
+                    if (I.getType()->isPointerTy()) {
+                        classes.uniteContent(I.getOperand(0), &I);
+                    }
+                }
             }
         }
+        classes.finalize();
     }
 }
 
 void ControlDependency::initVectorDeps(Module &M) {
+    CalleeRegistry &registry = getCalleeRegistry();
     std::set<Value*> finishedDeps;
     for (Function *F : TargetFuncPtrs) {
         finishedDeps.clear();
@@ -317,11 +347,10 @@ void ControlDependency::initVectorDeps(Module &M) {
                     if (II->getCalledFunction() == nullptr) {
                         continue;
                     }
-                    std::string calledFuncName = II->getCalledFunction()->getName();
-                    if (calledFuncName.find("push_back") != std::string::npos || calledFuncName.find("emplace_back") != std::string::npos) {
+                    if (registry.is(II->getCalledFunction(), CALLEE_VECTOR_PUSH)) {
                         if (II->arg_size() == 0) continue;
                         Instruction *vec = dyn_cast<Instruction>(&(II->getArgOperandUse(0)));
-                        if (isVectorType(vec)) {
+                        if (registry.isVectorType(vec)) {
                             VectorDeps[F].insert(&I);
                             VectorSources[F].insert(std::make_pair(vec, false));
                             finishedDeps.insert(vec);
@@ -333,7 +362,7 @@ void ControlDependency::initVectorDeps(Module &M) {
 
         BasicBlock &entry = F->getEntryBlock();
         for (Instruction &I : entry) {
-            if (I.getOpcode() == Instruction::Alloca && finishedDeps.find(&I) == finishedDeps.end() && isVectorType(&I)) {
+            if (I.getOpcode() == Instruction::Alloca && finishedDeps.find(&I) == finishedDeps.end() && registry.isVectorType(&I)) {
                 std::string varName = I.getName();
                 if (varName.find("finished") != std::string::npos) {
                     VectorSources[F].insert(std::make_pair(&I, false));
@@ -349,7 +378,7 @@ void ControlDependency::initVectorDeps(Module &M) {
             for (Instruction &I : BB) {
                 if (I.getOpcode() == Instruction::Store) {
                     Value *vec = dyn_cast<Value>(I.getOperand(1));
-                    if (!isVectorType(vec)) continue;
+                    if (!registry.isVectorType(vec)) continue;
                     for (auto s : VectorSources[F]) {
                         if (s.first == vec) {
                             if (!isa<Instruction>(I.getOperand(0))) continue;
@@ -370,50 +399,272 @@ void ControlDependency::initVectorDeps(Module &M) {
 
 // find sink BB from FunctionData map. If error or not found, return nullptr
 SinkBBNode *ControlDependency::getSinkBBNode(Function *F, BasicBlock *BB) {
-    if (FunctionData.find(F) == FunctionData.end()) {
+    auto index = SinkBBIndex.find(F);
+    if (index == SinkBBIndex.end()) {
         return nullptr;
     }
-    for (SinkBBNode *node : FunctionData[F]) {
-        if (node->BB == BB) {
-            return node;
+    auto node = index->second.find(BB);
+    return node == index->second.end() ? nullptr : node->second;
+}
+
+InstructionIds::InstructionIds(Function &F) {
+    operandOffsets.push_back(0);
+    for (Instruction &I : instructions(F)) {
+        ids[&I] = operandOffsets.size() - 1;
+        operandOffsets.push_back(operandOffsets.back() + I.getNumOperands());
+    }
+}
+
+bool MNode::lessUse(const ValueUse &a, const ValueUse &b) const {
+    unsigned aId = ids->getId(a.first), bId = ids->getId(b.first);
+    return aId < bId || (aId == bId && std::less<Value *>()(a.second, b.second));
+}
+
+void MNode::addInstr(Instruction *I) {
+    unsigned id = ids->getId(I);
+    auto it = std::lower_bound(instrs.begin(), instrs.end(), id, [&](Instruction *a, unsigned b) { return ids->getId(a) < b; });
+    if (it == instrs.end() || *it != I) {
+        instrs.insert(it, I);
+    }
+}
+
+void MNode::addDU(Instruction *I, Instruction *VI, Value *V) {
+    auto DU = std::make_pair(I, std::make_pair(VI, V));
+    auto it = std::lower_bound(DUs.begin(), DUs.end(), DU, [&](const std::pair<Instruction *, ValueUse> &a, const std::pair<Instruction *, ValueUse> &b) {
+        unsigned aId = ids->getId(a.first), bId = ids->getId(b.first);
+        return aId < bId || (aId == bId && lessUse(a.second, b.second));
+    });
+    if (it == DUs.end() || *it != DU) {
+        DUs.insert(it, DU);
+    }
+}
+
+void MNode::addUD(Instruction *VI, Value *V, Instruction *I) {
+    auto UD = std::make_pair(std::make_pair(VI, V), I);
+    auto it = std::lower_bound(UDs.begin(), UDs.end(), UD, [&](const std::pair<ValueUse, Instruction *> &a, const std::pair<ValueUse, Instruction *> &b) {
+        return lessUse(a.first, b.first) || (a.first == b.first && ids->getId(a.second) < ids->getId(b.second));
+    });
+    if (it == UDs.end() || *it != UD) {
+        UDs.insert(it, UD);
+    }
+}
+
+bool MNode::isInstrs(Instruction *I) const {
+    unsigned id = ids->getId(I);
+    auto it = std::lower_bound(instrs.begin(), instrs.end(), id, [&](Instruction *a, unsigned b) { return ids->getId(a) < b; });
+    return it != instrs.end() && *it == I;
+}
+
+std::pair<std::vector<std::pair<ValueUse, Instruction *>>::const_iterator, std::vector<std::pair<ValueUse, Instruction *>>::const_iterator> MNode::getUDs(Instruction *VI, Value *V) const {
+    ValueUse VP = std::make_pair(VI, V);
+    auto first = std::lower_bound(UDs.begin(), UDs.end(), VP, [&](const std::pair<ValueUse, Instruction *> &a, const ValueUse &b) { return lessUse(a.first, b); });
+    auto last = std::upper_bound(first, UDs.end(), VP, [&](const ValueUse &a, const std::pair<ValueUse, Instruction *> &b) { return lessUse(a, b.first); });
+    return std::make_pair(first, last);
+}
+
+unsigned AliasClasses::newNode(Value *V) {
+    parent.push_back(values.size());
+    rank.push_back(0);
+    contents.push_back(-1);
+    values.push_back(V);
+    return values.size() - 1;
+}
+
+unsigned AliasClasses::getNode(Value *V) {
+    auto node = nodes.find(V);
+    if (node != nodes.end()) {
+        return node->second;
+    }
+    unsigned id = newNode(V);
+    nodes[V] = id;
+    return id;
+}
+
+unsigned AliasClasses::find(unsigned node) {
+    while (parent[node] != node) {
+        // path halving
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+unsigned AliasClasses::getContent(unsigned node) {
+    unsigned root = find(node);
+    if (contents[root] < 0) {
+        unsigned content = newNode(nullptr);
+        contents[root] = content;
+    }
+    return contents[root];
+}
+
+void AliasClasses::join(unsigned a, unsigned b) {
+    // merging two classes merges what they point to as well
+    std::vector<std::pair<unsigned, unsigned>> pending(1, std::make_pair(a, b));
+    while (!pending.empty()) {
+        unsigned rootA = find(pending.back().first), rootB = find(pending.back().second);
+        pending.pop_back();
+        if (rootA == rootB) {
+            continue;
+        }
+        if (rank[rootA] < rank[rootB]) {
+            std::swap(rootA, rootB);
+        }
+        parent[rootB] = rootA;
+        if (rank[rootA] == rank[rootB]) {
+            rank[rootA]++;
+        }
+        if (contents[rootA] < 0) {
+            contents[rootA] = contents[rootB];
+        } else if (contents[rootB] >= 0) {
+            pending.push_back(std::make_pair(contents[rootA], contents[rootB]));
         }
     }
-    return nullptr;
 }
 
-// find MNode from MCFG map; If not found, try to initialize one
+void AliasClasses::unite(Value *a, Value *b) {
+    join(getNode(a), getNode(b));
+}
+
+void AliasClasses::uniteContent(Value *ptr, Value *value) {
+    unsigned node = getNode(value);
+    join(getContent(getNode(ptr)), node);
+}
+
+void AliasClasses::addDerived(Value *base, Value *gep) {
+    getNode(base);
+    getNode(gep);
+    derived[base].push_back(gep);
+}
+
+void AliasClasses::finalize() {
+    classIds.clear();
+    members.clear();
+    DenseMap<unsigned, std::vector<Value *>> rootMembers;
+    for (unsigned node = 0; node < values.size(); node++) {
+        if (values[node] != nullptr) {
+            rootMembers[find(node)].push_back(values[node]);
+        }
+    }
+    // class => id of its aliases, or -1 when a pointer has no other alias
+    DenseMap<unsigned, int> rootClass;
+    for (unsigned node = 0; node < values.size(); node++) {
+        if (values[node] == nullptr) {
+            continue;
+        }
+        unsigned root = find(node);
+        auto cls = rootClass.find(root);
+        if (cls == rootClass.end()) {
+            // the class, then the GEPs derived directly from its members (not the GEPs of those GEPs)
+            const std::vector<Value *> &classMembers = rootMembers[root];
+            std::vector<Value *> aliases = classMembers;
+            SmallPtrSet<Value *, 16> seen(aliases.begin(), aliases.end());
+            for (Value *member : classMembers) {
+                auto geps = derived.find(member);
+                if (geps == derived.end()) {
+                    continue;
+                }
+                for (Value *gep : geps->second) {
+                    if (seen.insert(gep).second) {
+                        aliases.push_back(gep);
+                    }
+                }
+            }
+            int id = -1;
+            if (aliases.size() > 1) {
+                id = members.size();
+                members.push_back(aliases);
+            }
+            cls = rootClass.insert(std::make_pair(root, id)).first;
+        }
+        if (cls->second >= 0) {
+            classIds[values[node]] = cls->second;
+        }
+    }
+}
+
+int AliasClasses::getClass(const Value *V) const {
+    auto cls = classIds.find(V);
+    return cls == classIds.end() ? -1 : cls->second;
+}
+
+MNode *FunctionSlice::newMNode(BasicBlock *BB, const InstructionIds *ids) {
+    if (!arena) {
+        arena.reset(new SpecificBumpPtrAllocator<MNode>());
+    }
+    return new (arena->Allocate()) MNode(BB, ids);
+}
+
+MNode *FunctionSlice::getMNode(BasicBlock *BB) {
+    auto node = index.find(BB);
+    return node == index.end() ? nullptr : node->second;
+}
+
+void FunctionSlice::addMNode(MNode *node) {
+    nodes.push_back(node);
+    // lookups return the first node of a BB
+    index.insert(std::make_pair(node->BB, node));
+}
+
+// find MNode from MCFG map. If not found, return nullptr
 MNode *ControlDependency::getMNode(Function *F, BasicBlock *BB) {
-    if (MCFG.find(F) == MCFG.end()) {
+    auto index = MNodeIndex.find(F);
+    if (index == MNodeIndex.end()) {
         return nullptr;
     }
-    for (MNode *node : MCFG[F]) {
-        if (node->BB == BB) {
-            return node;
-        }
+    auto node = index->second.find(BB);
+    return node == index->second.end() ? nullptr : node->second;
+}
+
+void ControlDependency::addSinkBBNode(Function *F, SinkBBNode *node) {
+    FunctionData[F].push_back(node);
+    // lookups return the first node of a BB
+    SinkBBIndex[F].insert(std::make_pair(node->BB, node));
+}
+
+void ControlDependency::reindexSinkBBNodes(Function *F) {
+    DenseMap<BasicBlock *, SinkBBNode *> &index = SinkBBIndex[F];
+    index.clear();
+    for (SinkBBNode *node : FunctionData[F]) {
+        index.insert(std::make_pair(node->BB, node));
     }
-    return nullptr;
 }
 
-std::set<Instruction *> ControlDependency::getDefinitions(Function *F, Instruction *I, Value *val) {
-    std::set<Instruction *> results;
-    // need reaching-definitions here
-    ReachingDefinitions &RD = getAnalysis<ReachingDefinitions>();
+const std::set<Instruction *> &ControlDependency::getDefinitions(Function *F, Instruction *I, Value *val) {
+    return lookupDefinitions(F, DefUses[F], I, val);
+}
+
+const std::set<Instruction *> &ControlDependency::lookupDefinitions(Function *F, DefUseTable &table, Instruction *I, Value *val) {
+    ValueUse use = std::make_pair(I, val);
+    auto cached = table.find(use);
+    if (cached != table.end()) {
+        return cached->second;
+    }
+    std::set<Instruction *> &results = table[use];
+    computeDefinitions(F, I, val, results);
+    return results;
+}
 
-    std::string funcName = demangle(F->getName().str().c_str());
-    if (RD.func_reaching_def.find(funcName) == RD.func_reaching_def.end() ||
-        RD.func_instr_bb_map.find(funcName) == RD.func_instr_bb_map.end() ||
-        RD.func_reaching_def[funcName].find(I) == RD.func_reaching_def[funcName].end()) {
+void ControlDependency::computeDefinitions(Function *F, Instruction *I, Value *val, std::set<Instruction *> &results) {
+    // need reaching-definitions here
+    FunctionReachingDefs *reachingDefs = RD->getFunctionReachingDefs(F);
+    if (reachingDefs == nullptr || !reachingDefs->hasReachingDefs(I)) {
         if (isa<Instruction>(val) && results.size() == 0) {
             results.insert(dyn_cast<Instruction>(val));
         }
-        return results;
+        return;
     }
 
-    std::set<Value *> vals = Alias[val];
-    vals.insert(val);
+    // val and the other members of its alias class
+    auto alias = Alias.find(F);
+    int aliasClass = alias == Alias.end() ? -1 : alias->second.getClass(val);
+    ArrayRef<Value *> vals = aliasClass < 0 ? ArrayRef<Value *>(val) : ArrayRef<Value *>(alias->second.getMembers(aliasClass));
 
+    std::vector<Value *> defs;
     for (Value *oneVal : vals) {
-        for (Value *def : RD.func_reaching_def[funcName][I]) {
+        defs.clear();
+        reachingDefs->getDefinitionsOf(I, oneVal, defs);
+        for (Value *def : defs) {
             if (!def) {
                 continue;
             }
@@ -421,16 +672,13 @@ std::set<Instruction *> ControlDependency::getDefinitions(Function *F, Instructi
                 continue;
             }
 
-            Value *defVar = valueToDefVar(def);
-            if (oneVal == defVar) {
-                if (isa<Instruction>(def)) {
-                    Instruction *defI = dyn_cast<Instruction>(def);
-                    if (results.find(defI) == results.end()) {
-                        if (isa<StoreInst>(defI) && isa<Instruction>(defI->getOperand(0))) {
-                            results.insert(dyn_cast<Instruction>(defI->getOperand(0)));
-                        } else {
-                            results.insert(defI);
-                        }
+            if (isa<Instruction>(def)) {
+                Instruction *defI = dyn_cast<Instruction>(def);
+                if (results.find(defI) == results.end()) {
+                    if (isa<StoreInst>(defI) && isa<Instruction>(defI->getOperand(0))) {
+                        results.insert(dyn_cast<Instruction>(defI->getOperand(0)));
+                    } else {
+                        results.insert(defI);
                     }
                 }
             }
@@ -439,7 +687,72 @@ std::set<Instruction *> ControlDependency::getDefinitions(Function *F, Instructi
     if (isa<Instruction>(val) && results.size() == 0) {
         results.insert(dyn_cast<Instruction>(val));
     }
-    return results;
+}
+
+const ControlDependenceGraph &ControlDependency::getControlDependenceGraph(Function &F) {
+    std::unique_ptr<ControlDependenceGraph> &CDG = CDGs[&F];
+    if (CDG) {
+        return *CDG;
+    }
+    CDG.reset(new ControlDependenceGraph());
+    PostDominatorTree &PDT = getAnalysis<PostDominatorTreeWrapperPass>(F).getPostDomTree();
+    unsigned numBlocks = 0;
+    for (BasicBlock &BB : F) {
+        CDG->blockIds[&BB] = numBlocks++;
+    }
+    // post-dominance facts sliceFunction needs, so that it does not build the tree again
+    PDT.updateDFSNumbers();
+    CDG->pdtIn.assign(numBlocks, -1);
+    CDG->pdtOut.assign(numBlocks, -1);
+    for (BasicBlock &BB : F) {
+        if (DomTreeNode *node = PDT.getNode(&BB)) {
+            unsigned id = CDG->blockIds[&BB];
+            CDG->pdtIn[id] = node->getDFSNumIn();
+            CDG->pdtOut[id] = node->getDFSNumOut();
+        }
+    }
+
+    // An edge A->B (with B not post-dominating A) puts A in the post-dominance frontier of every block on the
+    // post-dominator tree path from B up to (excluding) the immediate post-dominator of A. The paths are walked
+    // twice: once to size each block's row, once to fill it.
+    std::vector<unsigned> counts(numBlocks + 1, 0);
+    for (int fill = 0; fill < 2; fill++) {
+        for (BasicBlock &BB : F) {
+            BasicBlock *A = &BB;
+            for (succ_iterator succ = succ_begin(A), end = succ_end(A); succ != end; ++succ) {
+                BasicBlock *B = *succ;
+                if (!(A == B || !PDT.dominates(B, A)))
+                    continue;
+                unsigned edge = CDG->edges.size();
+                if (fill)
+                    CDG->edges.push_back(CDNode(A, B, getEdgeType(A, B)));
+                BasicBlock *lub = PDT[A]->getIDom()->getBlock();
+                for (BasicBlock *tmp = B; tmp != lub; tmp = PDT[tmp]->getIDom()->getBlock()) {
+                    unsigned id = CDG->blockIds[tmp];
+                    if (fill)
+                        CDG->deps[counts[id]++] = edge;
+                    else
+                        counts[id + 1]++;
+                }
+            }
+        }
+        if (!fill) {
+            for (unsigned id = 1; id < counts.size(); id++)
+                counts[id] += counts[id - 1];
+            CDG->offsets = counts;
+            CDG->deps.resize(counts.back());
+            counts.pop_back();
+        }
+    }
+    return *CDG;
+}
+
+const InstructionIds &ControlDependency::getInstructionIds(Function &F) {
+    std::unique_ptr<InstructionIds> &ids = InstrIds[&F];
+    if (!ids) {
+        ids.reset(new InstructionIds(F));
+    }
+    return *ids;
 }
 
 EdgeType ControlDependency::getEdgeType(const BasicBlock *A, const BasicBlock *B) {
@@ -467,12 +780,6 @@ EdgeType ControlDependency::getEdgeType(const BasicBlock *A, const BasicBlock *B
 
 void ControlDependency::buildCallGraph(Module *M, CallGraph *CG) {
     std::set<Function *> sinkCallee = TargetSinkPtrs;
-    // init CallChains
-    for (Function *sink : sinkCallee) {
-        std::vector<Function *> v;
-        v.push_back(sink);
-        CallChains.push_back(v);
-    }
     bool changed = true;
     while (changed) {
         changed = false;
@@ -509,7 +816,7 @@ void ControlDependency::buildCallGraph(Module *M, CallGraph *CG) {
                 // add sink block node
                 if (!getSinkBBNode(F, BB)) {
                     changed = true;
-                    FunctionData[F].push_back(new SinkBBNode(BB, I, F, calledFunc));
+                    addSinkBBNode(F, new (SinkBBArena.Allocate()) SinkBBNode(BB, I, F, calledFunc));
 #ifdef DEBUG
                     errs() << demangle(F->getName().str().c_str()) << " call " << demangle(calledFunc->getName().str().c_str()) << "\n";
 #endif              
@@ -518,36 +825,15 @@ void ControlDependency::buildCallGraph(Module *M, CallGraph *CG) {
                 if (sinkCallee.find(calledFunc) != sinkCallee.end()) {
                     sinkCallee.insert(F);
 
-                    // update CallChains
-                    std::vector<std::vector<Function *>> selectedChains;
-                    for (auto chain : CallChains) {
-                        if (chain.back() == calledFunc) {
-                            selectedChains.push_back(chain);
-                        }
-                    }
-                    for (auto chain : selectedChains) {
-                        chain.push_back(F);
-                        if (std::find(CallChains.begin(), CallChains.end(), chain) == CallChains.end()) {
-                            changed = true;
-                            CallChains.push_back(chain);
-                        }
+                    // update CallDAG
+                    if (CallDAG[F].insert(calledFunc).second) {
+                        changed = true;
                     }
                 }
             }
         }
     }
 
-    // clean chains
-    auto it = CallChains.begin();
-    while (it != CallChains.end()) {
-        std::string funcName = demangle(it->back()->getName().str().c_str());
-        if (TargetSources.find(funcName) == TargetSources.end()) {
-            it = CallChains.erase(it);
-        } else {
-            it++;
-        }
-    }
-
     // deal with internal calls
     for (Function *F : TargetFuncPtrs) {
         if (sinkCallee.find(F) == sinkCallee.end()) {
@@ -556,21 +842,26 @@ void ControlDependency::buildCallGraph(Module *M, CallGraph *CG) {
 #endif
             // it is an internal call
             for (auto it = FunctionData.begin(); it != FunctionData.end(); it++) {
+                bool erased = false;
                 auto sinkBB = it->second.begin();
                 while (sinkBB != it->second.end()) {
                     if ((*sinkBB)->to == F) {
                         InterCalls[(*sinkBB)->I] = F;
                         sinkBB = it->second.erase(sinkBB);
+                        erased = true;
                     } else {
                         sinkBB++;
                     }
                 }
+                if (erased) {
+                    reindexSinkBBNodes(it->first);
+                }
             }
             // set return instruction as the sinks
             for (BasicBlock &BB: *F) {
                 for (Instruction &I : BB) {
                     if (I.getOpcode() == Instruction::Ret) {
-                        FunctionData[F].push_back(new SinkBBNode(&BB, &I, F, nullptr));
+                        addSinkBBNode(F, new (SinkBBArena.Allocate()) SinkBBNode(&BB, &I, F, nullptr));
                     }
                 }
             }
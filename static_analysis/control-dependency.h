@@ -1,11 +1,16 @@
 #ifndef __CONTROL_DEPENDENCY_H__
 #define __CONTROL_DEPENDENCY_H__
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -18,6 +23,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <memory>
 
 #include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/CFGPrinter.h"
@@ -41,36 +47,98 @@ enum EdgeType {
     UNKNOWN
 };
 
+/** Dense numbering of the instructions of a function in layout order, and of their operand slots */
+class InstructionIds {
+   public:
+    InstructionIds(Function &F);
+
+    unsigned getId(const Instruction *I) const {
+        return ids.find(I)->second;
+    }
+    /** Id of operand slot opNo of I */
+    unsigned getOperandId(const Instruction *I, unsigned opNo) const {
+        return operandOffsets[getId(I)] + opNo;
+    }
+    unsigned getNumOperands() const {
+        return operandOffsets.back();
+    }
+
+   private:
+    DenseMap<const Instruction *, unsigned> ids;
+    // instruction id => id of its first operand slot, plus the total number of slots at the end
+    std::vector<unsigned> operandOffsets;
+};
+
+/** Unification-based (Steensgaard-style, field-insensitive) alias classes of the pointers of one function. Pointers are
+ * unified when they point to the same objects: a pointer cast with its operand, and through the contents of a location,
+ * a pointer stored to it with the pointers loaded from it. A GEP is not unified with its base: it is only derived from
+ * it, so the aliases of a pointer are its class plus, one way, the GEPs taken directly from a member of the class (a
+ * field never gets the definitions of its base or of its sibling fields, and a base not those of nested fields).
+ * Pointers with no alias but themselves get no id. */
+class AliasClasses {
+   public:
+    /** a and b point to the same objects */
+    void unite(Value *a, Value *b);
+    /** What is stored at / loaded from ptr points to the same objects as value */
+    void uniteContent(Value *ptr, Value *value);
+    /** derived (a GEP) points into the objects base points to */
+    void addDerived(Value *base, Value *derived);
+    /** Numbers the classes; call once every unite is done */
+    void finalize();
+    /** Dense id of the aliases of V, or -1 if V has none but itself */
+    int getClass(const Value *V) const;
+    /** Aliases of class id: its members, then the GEPs taken directly from them */
+    const std::vector<Value *> &getMembers(int id) const {
+        return members[id];
+    }
+
+   private:
+    // union-find forest over the pointers seen, plus anonymous (nullptr) nodes for contents never named by a value
+    DenseMap<Value *, unsigned> nodes;
+    std::vector<Value *> values;
+    std::vector<unsigned> parent;
+    std::vector<unsigned> rank;
+    // root => node of the class its pointers point to, or -1
+    std::vector<int> contents;
+    // base => GEPs derived from it
+    DenseMap<Value *, std::vector<Value *>> derived;
+    DenseMap<const Value *, unsigned> classIds;
+    std::vector<std::vector<Value *>> members;
+
+    unsigned getNode(Value *V);
+    unsigned newNode(Value *V);
+    unsigned find(unsigned node);
+    unsigned getContent(unsigned node);
+    void join(unsigned a, unsigned b);
+};
+
+/** A use of a value by an instruction */
+typedef std::pair<Instruction *, Value *> ValueUse;
+
 class MNode {
    public:
     BasicBlock *BB;
+    const InstructionIds *ids;
     std::set<EdgeType> edges;
-    std::set<Instruction *> instrs;
-    std::map<Instruction *, std::set<std::pair<Instruction *, Value *>>> DUs;
-    std::map<std::pair<Instruction *, Value *>, std::set<Instruction *>> UDs;
-    MNode(BasicBlock *BB) : BB(BB) {}
+    // selected instructions, sorted by instruction id (i.e. in block order)
+    std::vector<Instruction *> instrs;
+    // def => use pairs, sorted by def id, then use id
+    std::vector<std::pair<Instruction *, ValueUse>> DUs;
+    // use => def pairs, sorted by use id, then def id
+    std::vector<std::pair<ValueUse, Instruction *>> UDs;
+    MNode(BasicBlock *BB, const InstructionIds *ids) : BB(BB), ids(ids) {}
     void addEdges(EdgeType E) {
         edges.insert(E);
     }
-    void addInstr(Instruction *I) {
-        instrs.insert(I);
-    }
-    void addDU(Instruction *I, Instruction *VI, Value *V) {
-        if (DUs.find(I) == DUs.end()) {
-            DUs[I] = std::set<std::pair<Instruction *, Value *>>();
-        }
-        DUs[I].insert(std::make_pair(VI, V));
-    }
-    void addUD(Instruction *VI, Value *V, Instruction *I) {
-        auto VP = std::make_pair(VI, V);
-        if (UDs.find(VP) == UDs.end()) {
-            UDs[VP] = std::set<Instruction *>();
-        }
-        UDs[VP].insert(I);
-    }
-    bool isInstrs(Instruction *I) {
-        return instrs.find(I) != instrs.end();
-    }
+    void addInstr(Instruction *I);
+    void addDU(Instruction *I, Instruction *VI, Value *V);
+    void addUD(Instruction *VI, Value *V, Instruction *I);
+    bool isInstrs(Instruction *I) const;
+    /** Range of the UDs entries of the use of V by VI */
+    std::pair<std::vector<std::pair<ValueUse, Instruction *>>::const_iterator, std::vector<std::pair<ValueUse, Instruction *>>::const_iterator> getUDs(Instruction *VI, Value *V) const;
+
+   private:
+    bool lessUse(const ValueUse &a, const ValueUse &b) const;
 };
 
 class CDNode {
@@ -81,6 +149,45 @@ class CDNode {
     CDNode(BasicBlock *from, BasicBlock *to, EdgeType E) : from(from), to(to), E(E) {}
 };
 
+/** Control dependence graph of a function in compressed sparse row form. Block b (by id) is control dependent
+ * on the CFG edges edges[deps[i]] for i in [offsets[b], offsets[b + 1]), i.e. b is in the post-dominance
+ * frontier of the source of each of these edges. Edges are listed in function layout / successor order. */
+class ControlDependenceGraph {
+   public:
+    DenseMap<const BasicBlock *, unsigned> blockIds;
+    // one entry per CFG edge that some block is control dependent on
+    std::vector<CDNode> edges;
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> deps;
+    // block id => DFS numbers of its node in the post-dominator tree, or -1 if it has none
+    std::vector<int> pdtIn;
+    std::vector<int> pdtOut;
+
+    /** Whether A post-dominates B, with the same answers as PostDominatorTree::dominates */
+    bool postDominates(const BasicBlock *A, const BasicBlock *B) const {
+        if (A == B) {
+            return true;
+        }
+        unsigned a = blockIds.find(A)->second, b = blockIds.find(B)->second;
+        if (pdtIn[b] < 0) {
+            return true;
+        }
+        if (pdtIn[a] < 0) {
+            return false;
+        }
+        return pdtIn[a] <= pdtIn[b] && pdtOut[b] <= pdtOut[a];
+    }
+
+    /** Ids (into edges) of the CFG edges BB is control dependent on */
+    ArrayRef<unsigned> getDependences(const BasicBlock *BB) const {
+        auto id = blockIds.find(BB);
+        if (id == blockIds.end()) {
+            return ArrayRef<unsigned>();
+        }
+        return ArrayRef<unsigned>(deps.data() + offsets[id->second], offsets[id->second + 1] - offsets[id->second]);
+    }
+};
+
 class SinkBBNode {
    public:
     BasicBlock *BB;
@@ -90,6 +197,32 @@ class SinkBBNode {
     SinkBBNode(BasicBlock *BB, Instruction *I, Function *from, Function *to) : BB(BB), I(I), from(from), to(to) {}
 };
 
+/** use => definitions of the used value reaching the user */
+typedef std::map<ValueUse, std::set<Instruction *>> DefUseTable;
+
+/** Program slice of one function computed by ControlDependency. Filled in independently for each function
+ * (possibly on a worker thread) and merged into MCFG and the counters afterwards. */
+struct FunctionSlice {
+    Function *F;
+    // critical BBs, and BB => first node of that BB
+    std::vector<MNode *> nodes;
+    DenseMap<BasicBlock *, MNode *> index;
+    // definitions looked up while slicing
+    DefUseTable defUses;
+    unsigned int instr_cnt = 0;
+    unsigned int instr_total = 0;
+    unsigned int bb_cnt = 0;
+    unsigned int bb_total = 0;
+    // Buffered errs() output
+    std::string log;
+    // owns the MNodes of the slice
+    std::unique_ptr<SpecificBumpPtrAllocator<MNode>> arena;
+
+    MNode *newMNode(BasicBlock *BB, const InstructionIds *ids);
+    MNode *getMNode(BasicBlock *BB);
+    void addMNode(MNode *node);
+};
+
 class ControlDependency : public ModulePass {
    public:
     static char ID;
@@ -101,16 +234,17 @@ class ControlDependency : public ModulePass {
     // Source Functions
     std::set<std::string> TargetSources;
     std::set<Function *> TargetSourcePtrs;
-    // Sink Information for given function
+    // Sink Information for given function (add through addSinkBBNode)
     std::map<Function *, std::vector<SinkBBNode *>> FunctionData;
-    // Collection of critical BBs
+    // Collection of critical BBs (merged from each FunctionSlice)
     std::map<Function *, std::vector<MNode *>> MCFG;
-    // Simplified call graph
-    std::vector<std::vector<Function *>> CallChains;
+    // Simplified call graph: caller => callees it reaches a sink through. Every source -> sink call chain
+    // is a path in this DAG (calls closing a cycle are kept as edges; users skip them)
+    std::map<Function *, std::set<Function *>> CallDAG;
     // Internal functions (not in call graph but essential)
     std::map<Instruction *, Function *> InterCalls;
-    // alias caused by getelementptr
-    std::map<Value *, std::set<Value *>> Alias;
+    // alias classes of the pointers, per target function
+    std::map<Function *, AliasClasses> Alias;
     // vector dependencies: function => push_back
     std::map<Function *, std::set<Instruction *>> VectorDeps;
     std::map<Function *, std::set<std::pair<Value *, bool>>> VectorSources;
@@ -130,18 +264,24 @@ class ControlDependency : public ModulePass {
 
     virtual bool doFinalization(Module &M);
 
-    bool runOnFunction(Function &F);
+    /** Frees the nodes and per-function tables once the users of the pass are done with them */
+    virtual void releaseMemory();
 
     bool runOnModule(Module &M);
 
     EdgeType getEdgeType(const BasicBlock *A, const BasicBlock *BB);
+    /** Control dependence graph of F, built on first use and shared by every later query */
+    const ControlDependenceGraph &getControlDependenceGraph(Function &F);
+    /** Instruction numbering of F, built on first use */
+    const InstructionIds &getInstructionIds(Function &F);
     SinkBBNode *getSinkBBNode(Function *F, BasicBlock *BB);
     MNode *getMNode(Function *F, BasicBlock *BB);
-    std::set<Instruction *> getDefinitions(Function *F, Instruction *I, Value *val);
+    void addSinkBBNode(Function *F, SinkBBNode *node);
+    /** Definitions of val reaching I, memoized per (I, val) (mostly filled while slicing); the reference stays valid */
+    const std::set<Instruction *> &getDefinitions(Function *F, Instruction *I, Value *val);
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
         AU.addRequired<PostDominatorTreeWrapperPass>();
-        AU.addRequired<LoopInfoWrapperPass>();
         AU.addRequired<ReachingDefinitions>();
         AU.addRequired<CallGraphWrapperPass>();
         // AU.addRequired<MemoryDependenceWrapperPass>();
@@ -149,6 +289,26 @@ class ControlDependency : public ModulePass {
     }
 
    private:
+    // BB => first node of that BB in FunctionData[F] / MCFG[F], kept in step with the vectors
+    DenseMap<Function *, DenseMap<BasicBlock *, SinkBBNode *>> SinkBBIndex;
+    DenseMap<Function *, DenseMap<BasicBlock *, MNode *>> MNodeIndex;
+    DenseMap<Function *, std::unique_ptr<ControlDependenceGraph>> CDGs;
+    DenseMap<Function *, std::unique_ptr<InstructionIds>> InstrIds;
+    // node storage, freed by releaseMemory
+    std::vector<std::unique_ptr<SpecificBumpPtrAllocator<MNode>>> MNodeArenas;
+    SpecificBumpPtrAllocator<SinkBBNode> SinkBBArena;
+    ReachingDefinitions *RD = nullptr;
+    std::map<Function *, DefUseTable> DefUses;
+
+    void reindexSinkBBNodes(Function *F);
+
+    /** Only reads the pass state (with the CDG and instruction ids of F already built), so functions can be sliced concurrently */
+    void sliceFunction(Function &F, FunctionSlice &slice);
+    void mergeSlice(FunctionSlice &slice);
+    const std::set<Instruction *> &lookupDefinitions(Function *F, DefUseTable &table, Instruction *I, Value *val);
+    /** Only reads the pass state and the reaching definitions of F */
+    void computeDefinitions(Function *F, Instruction *I, Value *val, std::set<Instruction *> &results);
+
     void initVectorDeps(Module &M);
     void initAlias(Module &M);
     void buildCallGraph(Module &M);
@@ -0,0 +1,237 @@
+// Micro-benchmark for the dataflow engine and reaching definitions on synthetic functions.
+// Usage: ./dataflow-bench [-funcs N] [-blocks N] [-vars N] [-stores N] [-loop-depth N] [-loop-nests N]
+//                         [-call-density P] [-shape structured|random] [-seed N] [any -rd-*/-dataflow-* option]
+////////////////////////////////////////////////////////////////////////////////
+
+#include "reaching-definitions.h"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <random>
+
+using namespace llvm;
+
+static cl::opt<unsigned> NumFuncs("funcs", cl::desc("Number of synthetic functions"), cl::init(4));
+static cl::opt<unsigned> NumBlocks("blocks", cl::desc("Basic blocks per function"), cl::init(200));
+static cl::opt<unsigned> NumVars("vars", cl::desc("Stack variables per function"), cl::init(32));
+static cl::opt<unsigned> NumStores("stores", cl::desc("Load/add/store sequences per block"), cl::init(4));
+static cl::opt<unsigned> LoopDepth("loop-depth", cl::desc("Depth of each loop nest (structured shape)"), cl::init(2));
+static cl::opt<unsigned> LoopNests("loop-nests", cl::desc("Loop nests laid out one after another (structured shape)"), cl::init(2));
+static cl::opt<double> CallDensity("call-density", cl::desc("Probability that a block calls the callee with one of its variables"), cl::init(0.1));
+static cl::opt<std::string> Shape("shape", cl::desc("CFG shape: structured (nested loops and forward skips) or random (arbitrary back and forward edges)"), cl::init("structured"));
+static cl::opt<unsigned> Seed("seed", cl::desc("Random seed"), cl::init(1));
+
+/** Wall time of one benchmark phase and memory. getrusage only reports the peak RSS of the whole process
+ * so far, so the memory of a phase is shown as how much it raised that peak (0 if it stayed below an earlier one) */
+class Phase {
+   public:
+    Phase(const std::string& name) : name(name) {
+        startMaxRSS = getMaxRSS();
+        gettimeofday(&start, NULL);
+    }
+
+    void report(long iterations = -1) {
+        struct timeval end;
+        gettimeofday(&end, NULL);
+        long maxRSS = getMaxRSS();
+        double ms = ((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec)) / 1000.0;
+        outs() << format("%-12s %12.3f %12s %29ld %18ld\n", name.c_str(), ms,
+                         iterations < 0 ? "-" : std::to_string(iterations).c_str(), maxRSS, maxRSS - startMaxRSS);
+    }
+
+   private:
+    std::string name;
+    struct timeval start;
+    long startMaxRSS;
+
+    static long getMaxRSS() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+};
+
+/** i32 bench_callee(i32* p): redefines *p and returns its old value */
+static Function* buildCallee(Module& M) {
+    LLVMContext& C = M.getContext();
+    Type* I32 = Type::getInt32Ty(C);
+    FunctionType* FTy = FunctionType::get(I32, {PointerType::getUnqual(I32)}, false);
+    Function* F = Function::Create(FTy, Function::ExternalLinkage, "bench_callee", &M);
+    IRBuilder<> B(BasicBlock::Create(C, "entry", F));
+    Value* p = &*F->arg_begin();
+    Value* old = B.CreateLoad(I32, p);
+    B.CreateStore(B.getInt32(0), p);
+    B.CreateRet(old);
+    return F;
+}
+
+/** Branch targets of every block but the last (which returns) */
+static void buildCFGShape(std::vector<std::vector<int> >& targets, std::mt19937& rng) {
+    int n = NumBlocks;
+    targets.assign(n, std::vector<int>());
+    if (Shape == "random") {
+        //Fall through to the next block (so everything stays reachable) or jump anywhere
+        for (int i = 0; i + 1 < n; i++) {
+            targets[i].push_back(i + 1);
+            if (rng() % 2)
+                targets[i].push_back(rng() % n);
+        }
+        return;
+    }
+
+    //Nests of LoopDepth loops, laid out one after another: the latch of each loop branches back to its header
+    //or falls through; some other blocks skip ahead to the block after next
+    std::vector<int> latchHeader(n, -1);
+    int nests = std::max(1u, (unsigned)LoopNests);
+    int span = n / nests;
+    for (int nest = 0; nest < nests; nest++) {
+        int first = nest * span, last = first + span - 1;
+        for (int depth = 0; depth < (int)LoopDepth; depth++) {
+            int header = first + depth, latch = last - 1 - depth;
+            if (header >= latch || latch + 1 >= n)
+                break;
+            latchHeader[latch] = header;
+        }
+    }
+    for (int i = 0; i + 1 < n; i++) {
+        targets[i].push_back(i + 1);
+        if (latchHeader[i] >= 0)
+            targets[i].push_back(latchHeader[i]);
+        else if (i + 2 < n && rng() % 4 == 0)
+            targets[i].push_back(i + 2);
+    }
+}
+
+/** void bench_<idx>(i32* a, i32* b): straight-line load/add/store sequences over stack variables and both arguments */
+static Function* buildFunction(Module& M, int idx, Function* callee, std::mt19937& rng) {
+    LLVMContext& C = M.getContext();
+    Type* I32 = Type::getInt32Ty(C);
+    Type* I32Ptr = PointerType::getUnqual(I32);
+    FunctionType* FTy = FunctionType::get(Type::getVoidTy(C), {I32Ptr, I32Ptr}, false);
+    Function* F = Function::Create(FTy, Function::ExternalLinkage, "bench_" + std::to_string(idx), &M);
+
+    //(the entry block only sets up the variables, since it cannot be a loop header)
+    BasicBlock* entry = BasicBlock::Create(C, "entry", F);
+    std::vector<BasicBlock*> blocks;
+    for (unsigned i = 0; i < NumBlocks; i++)
+        blocks.push_back(BasicBlock::Create(C, "bb" + std::to_string(i), F));
+    IRBuilder<> B(entry);
+    std::vector<Value*> vars;
+    for (Function::arg_iterator arg = F->arg_begin(); arg != F->arg_end(); ++arg)
+        vars.push_back(&*arg);
+    for (unsigned i = 0; i < NumVars; i++) {
+        vars.push_back(B.CreateAlloca(I32, NULL, "v" + std::to_string(i)));
+        B.CreateStore(B.getInt32(i), vars.back());
+    }
+    B.CreateBr(blocks[0]);
+
+    std::vector<std::vector<int> > targets;
+    buildCFGShape(targets, rng);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    for (unsigned i = 0; i < NumBlocks; i++) {
+        B.SetInsertPoint(blocks[i]);
+        for (unsigned s = 0; s < NumStores; s++) {
+            Value* val = B.CreateLoad(I32, vars[rng() % vars.size()]);
+            B.CreateStore(B.CreateAdd(val, B.getInt32(s + 1)), vars[rng() % vars.size()]);
+        }
+        if (coin(rng) < CallDensity) {
+            Value* ret = B.CreateCall(callee, {vars[rng() % vars.size()]});
+            B.CreateStore(ret, vars[rng() % vars.size()]);
+        }
+        if (targets[i].empty()) {
+            B.CreateRetVoid();
+        } else if (targets[i].size() == 1) {
+            B.CreateBr(blocks[targets[i][0]]);
+        } else {
+            Value* cond = B.CreateICmpSLT(B.CreateLoad(I32, vars[rng() % vars.size()]), B.getInt32(i));
+            B.CreateCondBr(cond, blocks[targets[i][1]], blocks[targets[i][0]]);
+        }
+    }
+    return F;
+}
+
+int main(int argc, char** argv) {
+    cl::ParseCommandLineOptions(argc, argv, "dataflow and reaching definitions micro-benchmark\n");
+
+    LLVMContext C;
+    std::mt19937 rng(Seed);
+    outs() << left_justify("phase", 12) << right_justify("time (ms)", 13) << right_justify("iterations", 13) << right_justify("process peak RSS so far (KB)", 30) << right_justify("peak growth (KB)", 19) << "\n";
+
+    //Synthetic module
+    Phase build("build");
+    std::unique_ptr<Module> M(new Module("dataflow-bench", C));
+    std::vector<Function*> funcs;
+    funcs.push_back(buildCallee(*M));
+    for (unsigned i = 0; i < NumFuncs; i++)
+        funcs.push_back(buildFunction(*M, i, funcs[0], rng));
+    if (verifyModule(*M, &errs()))
+        return 1;
+    build.report();
+
+    //Whole per-function reaching definitions, callee first so its summary is available to the callers
+    ReachingDefinitions RD;
+    for (size_t i = 0; i < funcs.size(); i++)
+        RD.TargetFunc.insert(demangle(funcs[i]->getName().str().c_str()));
+    Phase rd("rd-function");
+    for (size_t i = 0; i < funcs.size(); i++)
+        RD.runOnFunction(*funcs[i]);
+    rd.report();
+
+    //The dataflow engine alone, over the domains computed above: block gen/kill summaries, then the fixpoint
+    std::vector<std::unique_ptr<ReachingDefinitionsDataFlow> > flows;
+    std::vector<std::vector<Value*> > domains;
+    for (size_t i = 0; i < funcs.size(); i++)
+        domains.push_back(RD.getFunctionReachingDefs(funcs[i])->domain);
+    Phase genKill("gen-kill");
+    for (size_t i = 0; i < funcs.size(); i++) {
+        flows.push_back(std::unique_ptr<ReachingDefinitionsDataFlow>(new ReachingDefinitionsDataFlow(domains[i])));
+        for (Function::iterator BB = funcs[i]->begin(); BB != funcs[i]->end(); ++BB)
+            flows[i]->getBlockSummary(&*BB);
+    }
+    genKill.report();
+
+    Phase solve("solve");
+    long iterations = 0;
+    std::set<BasicBlock*> prune_bb;
+    for (size_t i = 0; i < funcs.size(); i++) {
+        BitVector boundaryCond(domains[i].size(), false);
+        for (size_t j = 0; j < domains[i].size(); j++)
+            if (isa<Argument>(domains[i][j]))
+                boundaryCond.set(j);
+        DataFlowResult result;
+        flows[i]->run(*funcs[i], domains[i], DataFlowBase::FORWARD, boundaryCond, BitVector(domains[i].size(), false), prune_bb, result);
+        iterations += result.iterations;
+    }
+    solve.report(iterations);
+
+    //On-demand reaching definitions at every instruction
+    Phase queries("queries");
+    long numQueries = 0;
+    for (size_t i = 0; i < funcs.size(); i++) {
+        FunctionReachingDefs* reachingDefs = RD.getFunctionReachingDefs(funcs[i]);
+        for (Function::iterator BB = funcs[i]->begin(); BB != funcs[i]->end(); ++BB) {
+            for (BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I) {
+                if (!reachingDefs->hasReachingDefs(&*I))
+                    continue;
+                reachingDefs->getReachingDefs(&*I);
+                numQueries++;
+            }
+        }
+    }
+    queries.report();
+
+    outs() << "functions: " << funcs.size() << ", domain sizes:";
+    for (size_t i = 0; i < domains.size(); i++)
+        outs() << " " << domains[i].size();
+    outs() << ", queries: " << numQueries << "\n";
+    return 0;
+}
@@ -2,14 +2,23 @@
 // Group: bhumbers, psuresh
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <fstream>
 #include <set>
 #include <sstream>
 
 #include "dataflow.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace llvm {
 
 /* Var definition util */
@@ -107,119 +116,15 @@ bool hasDefinition(Value* v) {
     }
 }
 
-// Compute reaching def by iterating instructions within a BB until "instr_limit", store reaching def per instr in "def_set"
-void getBBReachDef(DenseMap<Value*, int>& domainEntryToValueIdx, BasicBlock* block, int instr_limit, std::map<Value*, std::map<Value*, std::set<std::string> > >& def_set) {
-    std::set<Value*> local_instr;
-    std::map<Value*, std::set<std::string> > local_def;
-    int instr_cnt = 0;
-    // Get all def vars in current BB
-    for (BasicBlock::iterator instruction = block->begin(); instruction != block->end(); ++instruction, instr_cnt++) {
-        local_instr.insert(&*instruction);
-        DenseMap<Value*, int>::const_iterator currDefIter = domainEntryToValueIdx.find(&*instruction);
-        if (currDefIter != domainEntryToValueIdx.end()) {
-            std::vector<Value*> def_var;
-            std::vector<std::string> def_field;
-            valueToAllDefinitionVar(currDefIter->first, def_var, def_field);
-            if (def_var.size() == 0)
-                continue;
-            for (int i = 0; i < def_var.size(); i++)
-                local_def[def_var[i]].insert(def_field[i]);
-        }
-        if (instr_cnt == instr_limit)
-            break;
-    }
-    /* 
-      std::string currDefStr = "";
-      for (std::set<std::string>::iterator it = local_def.begin(); it != local_def.end(); ++it)
-           currDefStr += (*it + ";");
-      if (currDefStr != "")
-          currDefStr = currDefStr.substr(0, currDefStr.length()-1);
-      //errs() << "getBBReach: currDefStr " << currDefStr << "\n";
-*/
-    // Add reaching defs in other BBs
-    for (DenseMap<Value*, int>::const_iterator prevDefIter = domainEntryToValueIdx.begin();
-         prevDefIter != domainEntryToValueIdx.end();
-         ++prevDefIter) {
-        if (local_instr.find(prevDefIter->first) == local_instr.end()) {
-            std::vector<Value*> def_var;
-            std::vector<std::string> def_field;
-            valueToAllDefinitionVar(prevDefIter->first, def_var, def_field);
-            std::map<Value*, std::set<std::string> > dedup_def;
-            for (int i = 0; i < def_var.size(); i++) {
-                if (local_def.find(def_var[i]) == local_def.end())
-                    dedup_def[def_var[i]].insert(def_field[i]);
-                else if (local_def[def_var[i]].find(def_field[i]) == local_def[def_var[i]].end())
-                    dedup_def[def_var[i]].insert(def_field[i]);
-            }
-            for (std::map<Value*, std::set<std::string> >::iterator it = dedup_def.begin(); it != dedup_def.end(); it++)
-                for (auto def_f : it->second)
-                    def_set[prevDefIter->first][it->first].insert(def_f);
-            //std::string prevDefStr = valueToDefinitionVarStr(prevDefIter->first);
-            //if (!includeDefVarWithField(prevDefStr, currDefStr))
-            //    def_set.insert(std::pair<Value*, std::string>(prevDefIter->first, dedupDefVarWithField(prevDefStr, currDefStr)));
-        }
-    }
-    //for (std::map<Value*, std::string>::iterator jt = def_set.begin(); jt != def_set.end(); jt++)
-    //     errs() << "getBBReach: def_set " << valueToStr(jt->first) << "\t" << jt->second << "\n";
-    // Add reaching defs in current BB
-    instr_cnt = 0;
-    for (BasicBlock::iterator instruction = block->begin(); instruction != block->end(); ++instruction, instr_cnt++) {
-        DenseMap<Value*, int>::const_iterator currDefIter = domainEntryToValueIdx.find(&*instruction);
-        if (currDefIter != domainEntryToValueIdx.end()) {
-            std::vector<Value*> def_var;
-            std::vector<std::string> def_field;
-            valueToAllDefinitionVar(currDefIter->first, def_var, def_field);
-            def_set[currDefIter->first] = std::map<Value*, std::set<std::string> >();
-            for (int i = 0; i < def_var.size(); i++)
-                def_set[currDefIter->first][def_var[i]].insert(def_field[i]);
-            //std::string currDefStr = valueToDefinitionVarStr(currDefIter->first);
-            //def_set.insert(std::pair<Value*, std::string>(currDefIter->first, currDefStr));
-            for (BasicBlock::iterator prevInst = block->begin(); prevInst != instruction; ++prevInst) {
-                DenseMap<Value*, int>::const_iterator prevDefIter = domainEntryToValueIdx.find(&*prevInst);
-                if (prevDefIter != domainEntryToValueIdx.end() && def_set.find(prevDefIter->first) != def_set.end()) {
-                    std::map<Value*, std::set<std::string> > dedup_def;
-                    bool overlapped = false;
-                    for (std::map<Value*, std::set<std::string> >::iterator it = def_set[prevDefIter->first].begin(); it != def_set[prevDefIter->first].end(); it++) {
-                        if (def_set[currDefIter->first].find(it->first) == def_set[currDefIter->first].end()) {
-                            for (auto def_f : it->second)
-                                dedup_def[it->first].insert(def_f);
-                        } else {
-                            for (auto def_f : it->second) {
-                                if (def_set[currDefIter->first][it->first].find(def_f) == def_set[currDefIter->first][it->first].end())
-                                    dedup_def[it->first].insert(def_f);
-                                else
-                                    overlapped = true;
-                            }
-                        }
-                    }
-                    if (dedup_def.size() == 0) {
-                        def_set.erase(prevDefIter->first);
-                    } else if (overlapped) {
-                        def_set[prevDefIter->first] = std::map<Value*, std::set<std::string> >();
-                        for (std::map<Value*, std::set<std::string> >::iterator it = dedup_def.begin(); it != dedup_def.end(); it++)
-                            for (auto def_f : it->second)
-                                def_set[prevDefIter->first][it->first].insert(def_f);
-                    }
-                    //std::string prevDefStr = def_set[prevDefIter->first];
-                    //if (includeDefVarWithField(prevDefStr, currDefStr))
-                    //    def_set.erase(prevDefIter->first);
-                    //else if (overlapDefVar(prevDefStr, currDefStr))
-                    //    def_set[prevDefIter->first] = dedupDefVarWithField(prevDefStr, currDefStr);
-                }
-            }
-        }
-        if (instr_cnt == instr_limit)
-            break;
-    }
-}
-
-void getFuncRedef(Function& F, std::vector<Value*>& domain, DataFlowResult& dataFlowResult) {
+void getFuncRedef(Function& F, std::vector<Value*>& domain, DataFlowResult& dataFlowResult, ArgRedefs& redefs, raw_ostream& OS) {
     std::string func = F.getName().str();
     std::map<Value*, std::set<std::string> > arg_redef;
     for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
         if (succ_begin(&(*basicBlock)) == succ_end(&(*basicBlock))) {
-            DataFlowResultForBlock blockReachingDefVals = dataFlowResult.resultsByBlock[&*basicBlock];
-            BitVector reachingDefVals = blockReachingDefVals.out;
+            if (!dataFlowResult.hasBlock(&*basicBlock))
+                continue;
+            BitVector reachingDefVals;
+            dataFlowResult.getOut(&*basicBlock, reachingDefVals);
             // Extract def var from each instruction in RD set and check if it has been defined previously
             for (int i = 0; i < domain.size(); i++) {
                 if (reachingDefVals[i]) {
@@ -293,63 +198,83 @@ void getFuncRedef(Function& F, std::vector<Value*>& domain, DataFlowResult& data
          errs() << "Arg RD: " << func_arg_rd[func][i] << "\n";
     setFuncRD(func, func_arg_rd[func]);
 */
-    for (std::map<Value*, std::set<std::string> >::iterator it = arg_redef.begin(); it != arg_redef.end(); it++) {
-        if (!isa<Argument>(it->first))
+    for (Function::arg_iterator arg = F.arg_begin(); arg != F.arg_end(); ++arg) {
+        std::map<Value*, std::set<std::string> >::iterator it = arg_redef.find(&*arg);
+        if (it == arg_redef.end())
             continue;
-        int idx = dyn_cast<Argument>(it->first)->getArgNo();
-        for (auto fd : arg_redef[it->first])
-            errs() << "Arg RD: " << idx << ":" << fd << "\n";
+        int idx = arg->getArgNo();
+        for (auto fd : it->second) {
+            OS << "Arg RD: " << idx << ":" << fd << "\n";
+            redefs.push_back(std::make_pair(idx, fd));
+        }
     }
 }
 
-std::string getCallee(Value* v) {
-    if (CallInst* CI = dyn_cast<CallInst>(v)) {
-        Function* fun = CI->getCalledFunction();
-        if (fun)
-            return fun->getName();
-    } else if (InvokeInst* CI = dyn_cast<InvokeInst>(v)) {
-        Function* fun = CI->getCalledFunction();
-        if (fun)
-            return fun->getName();
-    }
-    return "";
+const ArgRedefs* FuncRDSummaries::lookup(const Function* F) const {
+    DenseMap<const Function*, ArgRedefs>::const_iterator it = summaries.find(F);
+    return it == summaries.end() ? NULL : &it->second;
+}
+
+void FuncRDSummaries::set(const Function* F, const ArgRedefs& redefs) {
+    summaries[F] = redefs;
 }
 
-void setFuncRD(std::string func, std::vector<std::string>& idx) {
-    std::string file_name = func + ".df";
-    std::ofstream outfile;
-    outfile.open(file_name.c_str());
-    if (outfile.is_open()) {
-        for (int i = 0; i < idx.size(); i++)
-            outfile << idx[i] << "\n";
-        outfile.close();
+// Each line: the function name, then one tab-separated "idx" or "idx:field" entry per redefined argument
+bool FuncRDSummaries::save(const std::string& path) const {
+    std::map<std::string, const ArgRedefs*> sorted;
+    for (DenseMap<const Function*, ArgRedefs>::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+        sorted[it->first->getName().str()] = &it->second;
+
+    std::ofstream outfile(path.c_str());
+    if (!outfile.is_open())
+        return false;
+    for (std::map<std::string, const ArgRedefs*>::iterator it = sorted.begin(); it != sorted.end(); ++it) {
+        outfile << it->first;
+        for (int i = 0; i < it->second->size(); i++)
+            outfile << "\t" << (*it->second)[i].first << (*it->second)[i].second;
+        outfile << "\n";
     }
+    outfile.close();
+    return true;
 }
 
-std::string loadFuncRD(std::string func) {
-    std::string file_name = func + ".df";
-    std::ifstream infile;
-    std::string def_var = "";
-    std::string line;
-    infile.open(file_name.c_str());
+bool FuncRDSummaries::load(Module& M, const std::string& path) {
+    std::ifstream infile(path.c_str());
     if (!infile.is_open())
-        return "";
-    while (!infile.eof()) {
-        getline(infile, line);
-        if (line.length() == 0)
+        return false;
+    std::string line;
+    while (std::getline(infile, line)) {
+        std::istringstream fields(line);
+        std::string func;
+        if (!std::getline(fields, func, '\t'))
             continue;
-        def_var += (line + ";");
+        Function* F = M.getFunction(func);
+        if (F == NULL || summaries.find(F) != summaries.end())
+            continue;
+        ArgRedefs redefs;
+        std::string entry;
+        while (std::getline(fields, entry, '\t')) {
+            std::string::size_type sep = entry.find(":");
+            int idx = atoi(entry.substr(0, sep).c_str());
+            redefs.push_back(std::make_pair(idx, sep == std::string::npos ? "" : entry.substr(sep)));
+        }
+        summaries[F] = redefs;
     }
     infile.close();
-    if (def_var != "")
-        def_var = def_var.substr(0, def_var.length() - 1);
-    return def_var;
+    return true;
+}
+
+FuncRDSummaries& getFuncRDSummaries() {
+    static FuncRDSummaries summaries;
+    return summaries;
 }
 
 // arg id starting from 0
 Value* getCalleeArg(Value* v, int i) {
     if (i < 0)
         return NULL;
+    if (isa<CallBase>(v) && i >= dyn_cast<CallBase>(v)->arg_size())
+        return NULL;
     if (CallInst* CI = dyn_cast<CallInst>(v)) {
         Value* val = CI->getArgOperand(i);
         return val;
@@ -368,42 +293,14 @@ void valueToAllDefinitionVar(Value* v, std::vector<Value*>& def_var, std::vector
         def_var.push_back(((StoreInst*)v)->getPointerOperand());
         def_field.push_back("");
     } else if (isa<CallInst>(v) || isa<InvokeInst>(v)) {
-        // Read callee's dataflow profile to get any defined args and LHS (if any)
-        std::string def_str = "";
-        std::string callee_func = getCallee(v);
-        if (callee_func != "") {
-            std::string def_arg = loadFuncRD(callee_func);
-            //errs() << "Debug: " << callee_func << "###" << def_arg << "\n";
-            if (def_arg != "") {
-                while (def_arg.find(";") != std::string::npos) {
-                    std::string curr = def_arg.substr(0, def_arg.find(";"));
-                    int idx = -1;
-                    std::string field_idx = "";
-                    if (curr.find(":") != std::string::npos) {
-                        idx = atoi(curr.substr(0, curr.find(":")).c_str());
-                        field_idx = curr.substr(curr.find(":"));
-                    } else {
-                        idx = atoi(curr.c_str());
-                    }
-                    Value* callee_arg = getCalleeArg(v, idx);
-                    if (callee_arg != NULL) {
-                        def_var.push_back(callee_arg);
-                        def_field.push_back(field_idx);
-                    }
-                    def_arg = def_arg.substr(def_arg.find(";") + 1);
-                }
-                int idx = -1;
-                std::string field_idx = "";
-                if (def_arg.find(":") != std::string::npos) {
-                    idx = atoi(def_arg.substr(0, def_arg.find(":")).c_str());
-                    field_idx = def_arg.substr(def_arg.find(":"));
-                } else {
-                    idx = atoi(def_arg.c_str());
-                }
-                Value* callee_arg = getCalleeArg(v, idx);
+        // Look up callee's dataflow summary to get any defined args
+        const ArgRedefs* def_arg = getFuncRDSummaries().lookup(dyn_cast<CallBase>(v)->getCalledFunction());
+        if (def_arg != NULL) {
+            for (int i = 0; i < def_arg->size(); i++) {
+                Value* callee_arg = getCalleeArg(v, (*def_arg)[i].first);
                 if (callee_arg != NULL) {
                     def_var.push_back(callee_arg);
-                    def_field.push_back(field_idx);
+                    def_field.push_back((*def_arg)[i].second);
                 }
             }
         }
@@ -449,139 +346,196 @@ std::string setToStr(std::vector<Value*>& domain, const BitVector& includedInSet
 /* End string output utilities *
 ******************************************************************************************/
 
-DataFlowResult DataFlow::run(Function& F,
-                             std::vector<Value*>& domain,
-                             Direction direction,
-                             BitVector boundaryCond,
-                             BitVector initInteriorCond, std::set<BasicBlock*>& prune_bb) {
-    DenseMap<BasicBlock*, DataFlowResultForBlock> resultsByBlock;
-    bool analysisConverged = false;
-
-    //Create mapping from domain entries to linear indices
-    //(simplifies updating bitvector entries given a particular domain element)
-    DenseMap<Value*, int> domainEntryToValueIdx;
-    for (int i = 0; i < domain.size(); i++)
-        domainEntryToValueIdx[domain[i]] = i;
-
-    //Set initial val for boundary blocks, which depend on direction of analysis
-    std::set<BasicBlock*> boundaryBlocks;
-    switch (direction) {
-        case FORWARD:
-            boundaryBlocks.insert(&F.front());  //post-"entry" block = first in list
-            break;
-        case BACKWARD:
-            //Pre-"exit" blocks = those that have a return statement
-            for (Function::iterator I = F.begin(), E = F.end(); I != E; ++I)
-                if (isa<ReturnInst>(I->getTerminator()))
-                    boundaryBlocks.insert(&*I);
-            break;
+/******************************************************************************************
+ * Dataflow set storage */
+static cl::opt<std::string> DataFlowReprOpt("dataflow-repr", cl::desc("Representation of dataflow block sets: dense, sparse or auto (dense unless the bit matrix would exceed -dataflow-dense-limit MB)"), cl::init("auto"));
+static cl::opt<unsigned> DataFlowDenseLimit("dataflow-dense-limit", cl::desc("Largest bit matrix (in MB) the auto dataflow representation keeps dense"), cl::init(256));
+
+// 64-byte (cache line) rows
+static const unsigned ROW_ALIGN_WORDS = 8;
+
+void BitMatrix::init(unsigned rows, unsigned bits) {
+    numRows = rows;
+    numBits = bits;
+    rowWords = ((bits + 63) / 64 + ROW_ALIGN_WORDS - 1) / ROW_ALIGN_WORDS * ROW_ALIGN_WORDS;
+    //Over-allocate by a row's alignment so the first row can start on a cache line
+    storage.assign((size_t)rows * rowWords + ROW_ALIGN_WORDS, 0);
+    uintptr_t addr = (uintptr_t)storage.data();
+    uintptr_t align = ROW_ALIGN_WORDS * sizeof(uint64_t);
+    base = (uint64_t*)((addr + align - 1) / align * align);
+}
+
+// Row lengths are multiples of 8 words and rows are 64-byte aligned, so vector loops need no remainder handling
+#if defined(__AVX2__)
+void bitRowCopy(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 4)
+        _mm256_store_si256((__m256i*)(dst.words + i), _mm256_load_si256((const __m256i*)(src.words + i)));
+}
+
+void bitRowUnion(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 4) {
+        __m256i a = _mm256_load_si256((const __m256i*)(dst.words + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(src.words + i));
+        _mm256_store_si256((__m256i*)(dst.words + i), _mm256_or_si256(a, b));
     }
-    for (std::set<BasicBlock*>::iterator boundaryBlock = boundaryBlocks.begin(); boundaryBlock != boundaryBlocks.end(); boundaryBlock++) {
-        DataFlowResultForBlock boundaryResult = DataFlowResultForBlock();
-        //Set either the "IN" of post-entry blocks or the "OUT" of pre-exit blocks (since entry/exit blocks don't actually exist...)
-        BitVector* boundaryVal = (direction == FORWARD) ? &boundaryResult.in : &boundaryResult.out;
-        *boundaryVal = boundaryCond;
-        boundaryResult.currTransferResult.baseValue = boundaryCond;
-        resultsByBlock[*boundaryBlock] = boundaryResult;
+}
+
+void bitRowIntersect(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 4) {
+        __m256i a = _mm256_load_si256((const __m256i*)(dst.words + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(src.words + i));
+        _mm256_store_si256((__m256i*)(dst.words + i), _mm256_and_si256(a, b));
     }
+}
 
-    //Set initial vals for interior blocks (either OUTs for fwd analysis or INs for bwd analysis)
-    for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
-        if (prune_bb.find(&*basicBlock) != prune_bb.end()) continue;
-        if (boundaryBlocks.find(&*basicBlock) == boundaryBlocks.end()) {
-            DataFlowResultForBlock interiorInitResult = DataFlowResultForBlock();
-            BitVector* interiorInitVal = (direction == FORWARD) ? &interiorInitResult.out : &interiorInitResult.in;
-            *interiorInitVal = initInteriorCond;
-            interiorInitResult.currTransferResult.baseValue = initInteriorCond;
-            resultsByBlock[&*basicBlock] = interiorInitResult;
-        }
+void bitRowSubtract(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 4) {
+        __m256i a = _mm256_load_si256((const __m256i*)(dst.words + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(src.words + i));
+        _mm256_store_si256((__m256i*)(dst.words + i), _mm256_andnot_si256(b, a));
     }
+}
 
-    //Generate analysis "predecessor" list for each block (depending on direction of analysis)
-    //Will be used to drive the meet inputs.
-    DenseMap<BasicBlock*, std::vector<BasicBlock*> > analysisPredsByBlock;
-    for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
-        if (prune_bb.find(&*basicBlock) != prune_bb.end()) continue;
-        std::vector<BasicBlock*> analysisPreds;
-        switch (direction) {
-            case FORWARD:
-                for (pred_iterator predBlock = pred_begin(&*basicBlock), E = pred_end(&*basicBlock); predBlock != E; ++predBlock)
-                    analysisPreds.push_back(*predBlock);
-                break;
-            case BACKWARD:
-                for (succ_iterator succBlock = succ_begin(&*basicBlock), E = succ_end(&*basicBlock); succBlock != E; ++succBlock)
-                    analysisPreds.push_back(*succBlock);
-                break;
-        }
+void bitRowGenKill(BitRow dst, BitRow src, BitRow gen, BitRow kill) {
+    for (unsigned i = 0; i < dst.numWords; i += 4) {
+        __m256i in = _mm256_load_si256((const __m256i*)(src.words + i));
+        __m256i g = _mm256_load_si256((const __m256i*)(gen.words + i));
+        __m256i k = _mm256_load_si256((const __m256i*)(kill.words + i));
+        _mm256_store_si256((__m256i*)(dst.words + i), _mm256_or_si256(g, _mm256_andnot_si256(k, in)));
+    }
+}
 
-        analysisPredsByBlock[&*basicBlock] = analysisPreds;
+bool bitRowEqual(BitRow a, BitRow b) {
+    for (unsigned i = 0; i < a.numWords; i += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(a.words + i)), _mm256_load_si256((const __m256i*)(b.words + i)));
+        if (!_mm256_testz_si256(x, x))
+            return false;
     }
+    return true;
+}
+#elif defined(__SSE2__)
+void bitRowCopy(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 2)
+        _mm_store_si128((__m128i*)(dst.words + i), _mm_load_si128((const __m128i*)(src.words + i)));
+}
 
-    //Iterate over blocks in function until convergence of output sets for all blocks
-    while (!analysisConverged) {
-        analysisConverged = true;  //assume converged until proven otherwise during this iteration
-
-        //TODO: if analysis is backwards, may want instead to iterate from back-to-front of blocks list
-        // errs() << "run " << F.getName() << "\n";
-        for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
-            if (prune_bb.find(&*basicBlock) != prune_bb.end()) continue;
-            DataFlowResultForBlock& blockVals = resultsByBlock[&*basicBlock];
-
-            //Store old output before applying this analysis pass to the block (depends on analysis dir)
-            DataFlowResultForBlock oldBlockVals = blockVals;
-            BitVector oldPassOut = (direction == FORWARD) ? blockVals.out : blockVals.in;
-
-            //If any analysis predecessors have outputs ready, apply meet operator to generate updated input set for this block
-            BitVector* passInPtr = (direction == FORWARD) ? &blockVals.in : &blockVals.out;
-            std::vector<BasicBlock*> analysisPreds = analysisPredsByBlock[&*basicBlock];
-            std::vector<BitVector> meetInputs;
-            //Iterate over analysis predecessors in order to generate meet inputs for this block
-            // errs() << "run BB " << (*basicBlock).getName() << "\n";
-            for (std::vector<BasicBlock*>::iterator analysisPred = analysisPreds.begin(); analysisPred < analysisPreds.end(); ++analysisPred) {
-                if (prune_bb.find(*analysisPred) != prune_bb.end()) continue;
-                DataFlowResultForBlock& predVals = resultsByBlock[*analysisPred];
-
-                BitVector meetInput = predVals.currTransferResult.baseValue;
-
-                //If this pred matches a predecessor-specific value for the current block, union that value into value set
-                DenseMap<BasicBlock*, BitVector>::iterator predSpecificValueEntry = predVals.currTransferResult.predSpecificValues.find(&*basicBlock);
-                if (predSpecificValueEntry != predVals.currTransferResult.predSpecificValues.end()) {
-                    //            errs() << "Pred-specific meet input from " << (*analysisPred)->getName() << ": " <<bitVectorToStr(predSpecificValueEntry->second) << "\n";
-                    meetInput |= predSpecificValueEntry->second;
-                }
+void bitRowUnion(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 2) {
+        __m128i a = _mm_load_si128((const __m128i*)(dst.words + i));
+        __m128i b = _mm_load_si128((const __m128i*)(src.words + i));
+        _mm_store_si128((__m128i*)(dst.words + i), _mm_or_si128(a, b));
+    }
+}
 
-                meetInputs.push_back(meetInput);
-            }
-            //      errs() << "run BB " << (*basicBlock).getName() << " meet" << "\n";
-            if (!meetInputs.empty())
-                *passInPtr = applyMeet(meetInputs);
-
-            //      errs() << "run BB " << (*basicBlock).getName() << " " << domainEntryToValueIdx.size() << " transfer" << "\n";
-            //Apply transfer function to input set in order to get output set for this iteration
-            blockVals.currTransferResult = applyTransfer(*passInPtr, domainEntryToValueIdx, &*basicBlock);
-            BitVector* passOutPtr = (direction == FORWARD) ? &blockVals.out : &blockVals.in;
-            *passOutPtr = blockVals.currTransferResult.baseValue;
-
-            //      errs() << "run BB " << " done" << "\n"; //(*basicBlock).getName() << " done" << "\n";
-            //Update convergence: if the output set for this block has changed, then we've not converged for this iteration
-            if (analysisConverged) {
-                if (*passOutPtr != oldPassOut)
-                    analysisConverged = false;
-                else if (blockVals.currTransferResult.predSpecificValues.size() != oldBlockVals.currTransferResult.predSpecificValues.size())
-                    analysisConverged = false;
-                //(should really check whether contents of pred-specific values changed as well, but
-                // that doesn't happen when the pred-specific values are just a result of phi-nodes)
-            }
-        }
+void bitRowIntersect(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 2) {
+        __m128i a = _mm_load_si128((const __m128i*)(dst.words + i));
+        __m128i b = _mm_load_si128((const __m128i*)(src.words + i));
+        _mm_store_si128((__m128i*)(dst.words + i), _mm_and_si128(a, b));
+    }
+}
+
+void bitRowSubtract(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i += 2) {
+        __m128i a = _mm_load_si128((const __m128i*)(dst.words + i));
+        __m128i b = _mm_load_si128((const __m128i*)(src.words + i));
+        _mm_store_si128((__m128i*)(dst.words + i), _mm_andnot_si128(b, a));
     }
+}
 
-    DataFlowResult result;
-    result.domainEntryToValueIdx = domainEntryToValueIdx;
-    result.resultsByBlock = resultsByBlock;
-    return result;
+void bitRowGenKill(BitRow dst, BitRow src, BitRow gen, BitRow kill) {
+    for (unsigned i = 0; i < dst.numWords; i += 2) {
+        __m128i in = _mm_load_si128((const __m128i*)(src.words + i));
+        __m128i g = _mm_load_si128((const __m128i*)(gen.words + i));
+        __m128i k = _mm_load_si128((const __m128i*)(kill.words + i));
+        _mm_store_si128((__m128i*)(dst.words + i), _mm_or_si128(g, _mm_andnot_si128(k, in)));
+    }
+}
+
+bool bitRowEqual(BitRow a, BitRow b) {
+    for (unsigned i = 0; i < a.numWords; i += 2) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)(a.words + i)), _mm_load_si128((const __m128i*)(b.words + i)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            return false;
+    }
+    return true;
+}
+#else
+void bitRowCopy(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i++)
+        dst.words[i] = src.words[i];
 }
 
-void DataFlow::PrintInstructionOps(raw_ostream& O, const Instruction* I) {
+void bitRowUnion(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i++)
+        dst.words[i] |= src.words[i];
+}
+
+void bitRowIntersect(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i++)
+        dst.words[i] &= src.words[i];
+}
+
+void bitRowSubtract(BitRow dst, BitRow src) {
+    for (unsigned i = 0; i < dst.numWords; i++)
+        dst.words[i] &= ~src.words[i];
+}
+
+void bitRowGenKill(BitRow dst, BitRow src, BitRow gen, BitRow kill) {
+    for (unsigned i = 0; i < dst.numWords; i++)
+        dst.words[i] = gen.words[i] | (src.words[i] & ~kill.words[i]);
+}
+
+bool bitRowEqual(BitRow a, BitRow b) {
+    for (unsigned i = 0; i < a.numWords; i++)
+        if (a.words[i] != b.words[i])
+            return false;
+    return true;
+}
+#endif
+
+void DenseDataFlowSets::toBitVector(Set s, unsigned numBits, BitVector& value) {
+    value.clear();
+    value.resize(numBits);
+    for (unsigned i = 0; i < s.numWords; i++) {
+        for (uint64_t word = s.words[i]; word != 0; word &= word - 1)
+            value.set(i * 64 + countTrailingZeros(word));
+    }
+}
+
+void DenseDataFlowSets::fromBitVector(Set s, const BitVector& value) {
+    for (unsigned i = 0; i < s.numWords; i++)
+        s.words[i] = 0;
+    for (int i = value.find_first(); i != -1; i = value.find_next(i))
+        set(s, i);
+}
+
+void SparseDataFlowSets::toBitVector(Set s, unsigned numBits, BitVector& value) {
+    value.clear();
+    value.resize(numBits);
+    for (SparseBitVector<>::iterator it = s->begin(); it != s->end(); ++it)
+        value.set(*it);
+}
+
+void SparseDataFlowSets::fromBitVector(Set s, const BitVector& value) {
+    s->clear();
+    for (int i = value.find_first(); i != -1; i = value.find_next(i))
+        s->set(i);
+}
+
+DataFlowRepr chooseDataFlowRepr(unsigned numSets, unsigned numBits) {
+    if (DataFlowReprOpt == "dense")
+        return DATAFLOW_DENSE;
+    if (DataFlowReprOpt == "sparse")
+        return DATAFLOW_SPARSE;
+    size_t rowBytes = ((numBits + 63) / 64 + ROW_ALIGN_WORDS - 1) / ROW_ALIGN_WORDS * ROW_ALIGN_WORDS * sizeof(uint64_t);
+    return (size_t)numSets * rowBytes > (size_t)DataFlowDenseLimit * 1024 * 1024 ? DATAFLOW_SPARSE : DATAFLOW_DENSE;
+}
+
+/* End dataflow set storage *
+******************************************************************************************/
+
+void DataFlowBase::PrintInstructionOps(raw_ostream& O, const Instruction* I) {
     O << "\nOps: {";
     if (I != NULL) {
         for (Instruction::const_op_iterator OI = I->op_begin(), OE = I->op_end();
@@ -594,7 +548,7 @@ void DataFlow::PrintInstructionOps(raw_ostream& O, const Instruction* I) {
     O << "}\n";
 }
 
-void DataFlow::ExampleFunctionPrinter(raw_ostream& O, const Function& F) {
+void DataFlowBase::ExampleFunctionPrinter(raw_ostream& O, const Function& F) {
     for (Function::const_iterator FI = F.begin(), FE = F.end(); FI != FE; ++FI) {
         const BasicBlock* block = &*FI;
         O << block->getName() << ":\n";
@@ -5,15 +5,24 @@
 #ifndef __CLASSICAL_DATAFLOW_DATAFLOW_H__
 #define __CLASSICAL_DATAFLOW_DATAFLOW_H__
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/ValueMap.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -30,18 +39,34 @@ Value* valueToDefinitionVar(Value* v);
 
 void valueToAllDefinitionVar(Value* v, std::vector<Value*>& def_var, std::vector<std::string>& def_field);
 
-std::string getCallee(Value* v);
-
 Value* getCalleeArg(Value* v, int i);
 
-std::string loadFuncRD(std::string func);
+/** Arguments (by index) a function may redefine, each with the field path below it ("" for the argument itself) */
+typedef std::vector<std::pair<int, std::string> > ArgRedefs;
+
+/** Interprocedural argument redefinition ("Arg RD") summaries of the analyzed functions.
+ * valueToAllDefinitionVar consults them for the arguments redefined by a call. */
+class FuncRDSummaries {
+   public:
+    /** Summary of F, or null if F has not been summarized */
+    const ArgRedefs* lookup(const Function* F) const;
+
+    void set(const Function* F, const ArgRedefs& redefs);
 
-void setFuncRD(std::string func, std::vector<std::string>& idx);
+    /** Writes every summary to a single file, one line per function keyed by its (mangled) name */
+    bool save(const std::string& path) const;
+
+    /** Reads the summaries written by save for the functions of M that have not been summarized yet */
+    bool load(Module& M, const std::string& path);
+
+   private:
+    DenseMap<const Function*, ArgRedefs> summaries;
+};
 
-void getBBReachDef(DenseMap<Value*, int>& domainEntryToValueIdx, BasicBlock* block, int instr_limit, std::map<Value*, std::map<Value*, std::set<std::string> > >& def_set);
+FuncRDSummaries& getFuncRDSummaries();
 
 // Generate function summary
-void getFuncRedef(Function& F, std::vector<Value*>& domain, DataFlowResult& dataFlowResult);
+void getFuncRedef(Function& F, std::vector<Value*>& domain, DataFlowResult& dataFlowResult, ArgRedefs& redefs, raw_ostream& OS);
 
 /** Util to create string representation of given BitVector */
 std::string bitVectorToStr(const BitVector& bv);
@@ -63,33 +88,125 @@ std::string valueToDefinitionStr(Value* v);
  * eg: The defining instruction "%a = add nsw i32 %b, 1" will return "a"*/
 std::string valueToDefinitionVarStr(Value* v);
 
-/** An intermediate transfer function output entry from a block. In addition to the main value,
- * may include a list of predecessor block-specific transfer values which are appended (unioned)
- * onto the main value for the meet operator input of each predecessor (used to handle SSA phi nodes) */
-struct TransferResult {
-    BitVector baseValue;
-    DenseMap<BasicBlock*, BitVector> predSpecificValues;
-};
-
 struct ReachingDef {
     Value* op_def;
     std::string op_field;
     int op_idx;
 };
 
-struct DataFlowResultForBlock {
-    //Final output
-    BitVector in;
-    BitVector out;
+/** A row of a BitMatrix: a 64-byte aligned run of words whose padding bits are kept clear */
+struct BitRow {
+    uint64_t* words;
+    unsigned numWords;
+};
+
+/** Fixed-size bit sets stored as the rows of one contiguous, cache-line aligned matrix */
+class BitMatrix {
+   public:
+    BitMatrix() : base(NULL), numRows(0), numBits(0), rowWords(0) {}
 
-    //Intermediate results
-    TransferResult currTransferResult;
+    void init(unsigned rows, unsigned bits);
 
-    DataFlowResultForBlock() {}
-    DataFlowResultForBlock(BitVector in, BitVector out) {
-        this->in = in;
-        this->out = out;
-        this->currTransferResult.baseValue = out;  //tra
+    BitRow row(unsigned r) const {
+        BitRow row = {base + (size_t)r * rowWords, rowWords};
+        return row;
+    }
+
+    unsigned rows() const { return numRows; }
+    unsigned bits() const { return numBits; }
+
+   private:
+    std::vector<uint64_t> storage;
+    uint64_t* base;
+    unsigned numRows;
+    unsigned numBits;
+    // words per row, rounded up to a whole number of cache lines
+    unsigned rowWords;
+};
+
+/* Row kernels (SSE2/AVX2 when available). Rows passed together must have the same length. */
+void bitRowCopy(BitRow dst, BitRow src);
+void bitRowUnion(BitRow dst, BitRow src);
+void bitRowIntersect(BitRow dst, BitRow src);
+void bitRowSubtract(BitRow dst, BitRow src);
+/** dst = gen | (src & ~kill) */
+void bitRowGenKill(BitRow dst, BitRow src, BitRow gen, BitRow kill);
+bool bitRowEqual(BitRow a, BitRow b);
+
+/** Dataflow set representations. Both offer the same static operations on cheap Set handles,
+ * so analyses and the solver can be written once for either of them. */
+
+/** Dense sets: rows of a BitMatrix */
+struct DenseDataFlowSets {
+    typedef BitRow Set;
+    BitMatrix matrix;
+
+    void init(unsigned numSets, unsigned numBits) { matrix.init(numSets, numBits); }
+    Set get(unsigned i) { return matrix.row(i); }
+
+    static void assign(Set dst, Set src) { bitRowCopy(dst, src); }
+    static void unite(Set dst, Set src) { bitRowUnion(dst, src); }
+    static void intersect(Set dst, Set src) { bitRowIntersect(dst, src); }
+    static void subtract(Set dst, Set src) { bitRowSubtract(dst, src); }
+    static void genKill(Set dst, Set src, Set gen, Set kill) { bitRowGenKill(dst, src, gen, kill); }
+    static bool equal(Set a, Set b) { return bitRowEqual(a, b); }
+    static bool test(Set s, unsigned bit) { return (s.words[bit / 64] >> (bit % 64)) & 1; }
+    static void set(Set s, unsigned bit) { s.words[bit / 64] |= (uint64_t)1 << (bit % 64); }
+    static void toBitVector(Set s, unsigned numBits, BitVector& value);
+    static void fromBitVector(Set s, const BitVector& value);
+};
+
+/** Sparse sets, for huge domains whose sets stay small */
+struct SparseDataFlowSets {
+    typedef SparseBitVector<>* Set;
+    std::vector<SparseBitVector<> > sets;
+
+    void init(unsigned numSets, unsigned /* numBits */) { sets.assign(numSets, SparseBitVector<>()); }
+    Set get(unsigned i) { return &sets[i]; }
+
+    static void assign(Set dst, Set src) { *dst = *src; }
+    static void unite(Set dst, Set src) { *dst |= *src; }
+    static void intersect(Set dst, Set src) { *dst &= *src; }
+    static void subtract(Set dst, Set src) { dst->intersectWithComplement(*src); }
+    static void genKill(Set dst, Set src, Set gen, Set kill) {
+        dst->intersectWithComplement(*src, *kill);
+        *dst |= *gen;
+    }
+    static bool equal(Set a, Set b) { return *a == *b; }
+    static bool test(Set s, unsigned bit) { return s->test(bit); }
+    static void set(Set s, unsigned bit) { s->set(bit); }
+    static void toBitVector(Set s, unsigned numBits, BitVector& value);
+    static void fromBitVector(Set s, const BitVector& value);
+};
+
+enum DataFlowRepr {
+    DATAFLOW_DENSE,
+    DATAFLOW_SPARSE
+};
+
+/** Representation for numSets sets over a domain of numBits elements, as chosen by -dataflow-repr
+ * (by default dense, unless the matrix would be huge) */
+DataFlowRepr chooseDataFlowRepr(unsigned numSets, unsigned numBits);
+
+/** Type-erased view of the sets a solver run leaves behind */
+class BlockSets {
+   public:
+    virtual ~BlockSets() {}
+    virtual void get(unsigned i, BitVector& value) const = 0;
+    virtual bool test(unsigned i, unsigned bit) const = 0;
+};
+
+template <typename Sets>
+class BlockSetsOf final : public BlockSets {
+   public:
+    Sets sets;
+    unsigned numBits;
+
+    void get(unsigned i, BitVector& value) const {
+        Sets::toBitVector(const_cast<Sets&>(sets).get(i), numBits, value);
+    }
+    bool test(unsigned i, unsigned bit) const {
+        return Sets::test(const_cast<Sets&>(sets).get(i), bit);
     }
 };
 
@@ -97,41 +214,225 @@ struct DataFlowResult {
     /** Mapping from domain entries to linear indices into value results from dataflow */
     DenseMap<Value*, int> domainEntryToValueIdx;
 
-    /** Mapping from basic blocks to the IN and OUT value sets for each after analysis converges */
-    DenseMap<BasicBlock*, DataFlowResultForBlock> resultsByBlock;
+    /** Dense id of each analyzed basic block, in visiting order */
+    DenseMap<BasicBlock*, unsigned> blockIds;
+
+    /** The IN and OUT value sets of each block after analysis converges, as sets
+     * setsPerBlock * id and setsPerBlock * id + 1 (the others are analysis scratch) */
+    std::unique_ptr<BlockSets> sets;
+    unsigned setsPerBlock = 2;
+
+    /** Block visits (transfer function applications) it took to reach the fixpoint */
+    unsigned iterations = 0;
+
+    /** Whether block was analyzed (i.e. not pruned) */
+    bool hasBlock(BasicBlock* block) const { return blockIds.find(block) != blockIds.end(); }
+
+    void getIn(BasicBlock* block, BitVector& value) const { sets->get(setsPerBlock * blockIds.find(block)->second, value); }
+    void getOut(BasicBlock* block, BitVector& value) const { sets->get(setsPerBlock * blockIds.find(block)->second + 1, value); }
+    bool inContains(BasicBlock* block, unsigned idx) const { return sets->test(setsPerBlock * blockIds.find(block)->second, idx); }
+    bool outContains(BasicBlock* block, unsigned idx) const { return sets->test(setsPerBlock * blockIds.find(block)->second + 1, idx); }
 };
 
-/** Base interface for running dataflow analysis passes.
- * Must be subclassed with pass-specific logic in order to be used.
-*/
-class DataFlow {
+/** Analysis-independent part of the dataflow solver */
+class DataFlowBase {
    public:
     enum Direction {
         FORWARD,
         BACKWARD
     };
 
-    /** Run this dataflow analysis on function using given parameters.*/
-    DataFlowResult run(Function& F,
-                       std::vector<Value*>& domain,
-                       Direction direction,
-                       BitVector boundaryCond,
-                       BitVector initInteriorCond, std::set<BasicBlock*>& prune_bb);
-
     /** Prints a representation of F to raw_ostream O. */
     void ExampleFunctionPrinter(raw_ostream& O, const Function& F);
 
     void PrintInstructionOps(raw_ostream& O, const Instruction* I);
+};
+
+/** Dataflow solver specialized at compile time for an analysis, which derives from DataFlow<Analysis> (CRTP).
+ * Sets are handles of one of the *DataFlowSets representations. The analysis provides (non-virtual,
+ * accessible to DataFlow<Analysis>):
+ *   template <typename Sets> void meet(typename Sets::Set acc, typename Sets::Set input)
+ *       -- acc = acc MEET input, in place
+ *   template <typename Sets> void transfer(typename Sets::Set in, typename Sets::Set out, typename Sets::Set* aux, BasicBlock* block)
+ *       -- out = f(in), overwriting out
+ * It may also ask for auxSetsPerBlock per-block sets (e.g. gen/kill), filled once by initBlockSets and
+ * handed to transfer, and shadow meetEdge to adjust the value flowing along particular edges (e.g. for phi nodes).
+ * All sets live in one preallocated store; meets and transfers write into them without further allocation. */
+template <typename Analysis>
+class DataFlow : public DataFlowBase {
+   public:
+    static const unsigned auxSetsPerBlock = 0;
+
+    /** Run this dataflow analysis on function using given parameters, filling result in place. */
+    void run(Function& F,
+             std::vector<Value*>& domain,
+             Direction direction,
+             const BitVector& boundaryCond,
+             const BitVector& initInteriorCond, std::set<BasicBlock*>& prune_bb,
+             DataFlowResult& result);
 
    protected:
-    /** Meet operator behavior; specific to the subclassing data flow */
-    virtual BitVector applyMeet(std::vector<BitVector>& meetInputs) = 0;
+    template <typename Sets>
+    void initBlockSets(typename Sets::Set* aux, BasicBlock* block) {}
+
+    /** Merges predOut, the output of analysis predecessor pred, into acc, the input of block.
+     * first is set for the first predecessor, whose output overwrites acc. */
+    template <typename Sets>
+    void meetEdge(typename Sets::Set acc, typename Sets::Set predOut, BasicBlock* pred, BasicBlock* block, bool first) {
+        if (first)
+            Sets::assign(acc, predOut);
+        else
+            static_cast<Analysis*>(this)->template meet<Sets>(acc, predOut);
+    }
 
-    /** Transfer function behavior; specific to a subclassing data flow
-     * domainEntryToValueIdx provides mapping from domain elements to the linear bitvector index for that element. */
-    virtual TransferResult applyTransfer(const BitVector& value, DenseMap<Value*, int>& domainEntryToValueIdx, BasicBlock* block) = 0;
+   private:
+    template <typename Sets>
+    void solve(Direction direction, const BitVector& boundaryCond, const BitVector& initInteriorCond,
+               std::vector<BasicBlock*>& blockOrder, std::vector<bool>& isBoundary,
+               std::vector<std::vector<int> >& analysisPredsByBlock, std::vector<std::vector<int> >& analysisSuccsByBlock,
+               DataFlowResult& result);
 };
 
+template <typename Analysis>
+void DataFlow<Analysis>::run(Function& F,
+                             std::vector<Value*>& domain,
+                             Direction direction,
+                             const BitVector& boundaryCond,
+                             const BitVector& initInteriorCond, std::set<BasicBlock*>& prune_bb,
+                             DataFlowResult& result) {
+    //Create mapping from domain entries to linear indices
+    //(simplifies updating bitvector entries given a particular domain element)
+    DenseMap<Value*, int>& domainEntryToValueIdx = result.domainEntryToValueIdx;
+    domainEntryToValueIdx.clear();
+    for (int i = 0; i < domain.size(); i++)
+        domainEntryToValueIdx[domain[i]] = i;
+
+    //Visiting order: reverse post-order for forward analyses, post-order for backward ones.
+    //Blocks the traversal from the entry does not reach (but which were not pruned) go last, in layout order.
+    //The position of a block in this order is its dense id.
+    std::vector<BasicBlock*> traversal;
+    ReversePostOrderTraversal<Function*> rpot(&F);
+    for (typename ReversePostOrderTraversal<Function*>::rpo_iterator it = rpot.begin(); it != rpot.end(); ++it)
+        traversal.push_back(*it);
+    if (direction == BACKWARD)
+        std::reverse(traversal.begin(), traversal.end());
+
+    std::vector<BasicBlock*> blockOrder;
+    DenseMap<BasicBlock*, unsigned>& blockOrderIdx = result.blockIds;
+    blockOrderIdx.clear();
+    for (std::vector<BasicBlock*>::iterator it = traversal.begin(); it != traversal.end(); ++it) {
+        if (prune_bb.find(*it) != prune_bb.end()) continue;
+        blockOrderIdx[*it] = blockOrder.size();
+        blockOrder.push_back(*it);
+    }
+    for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
+        if (prune_bb.find(&*basicBlock) != prune_bb.end()) continue;
+        if (blockOrderIdx.find(&*basicBlock) != blockOrderIdx.end()) continue;
+        blockOrderIdx[&*basicBlock] = blockOrder.size();
+        blockOrder.push_back(&*basicBlock);
+    }
+
+    //Boundary blocks: the post-"entry" block for forward analyses, pre-"exit" ones (those that return) for backward ones
+    std::vector<bool> isBoundary(blockOrder.size());
+    for (int idx = 0; idx < blockOrder.size(); idx++)
+        isBoundary[idx] = (direction == FORWARD) ? blockOrder[idx] == &F.front() : isa<ReturnInst>(blockOrder[idx]->getTerminator());
+
+    //Generate analysis "predecessor" and "successor" lists for each block (depending on direction of analysis)
+    //Predecessors drive the meet inputs; successors are re-queued when a block's output changes.
+    std::vector<std::vector<int> > analysisPredsByBlock(blockOrder.size());
+    std::vector<std::vector<int> > analysisSuccsByBlock(blockOrder.size());
+    for (int idx = 0; idx < blockOrder.size(); idx++) {
+        BasicBlock* basicBlock = blockOrder[idx];
+        std::vector<int>& forwardPreds = (direction == FORWARD) ? analysisPredsByBlock[idx] : analysisSuccsByBlock[idx];
+        std::vector<int>& forwardSuccs = (direction == FORWARD) ? analysisSuccsByBlock[idx] : analysisPredsByBlock[idx];
+        for (succ_iterator succBlock = succ_begin(basicBlock), E = succ_end(basicBlock); succBlock != E; ++succBlock) {
+            DenseMap<BasicBlock*, unsigned>::iterator succIdx = blockOrderIdx.find(*succBlock);
+            if (succIdx != blockOrderIdx.end())
+                forwardSuccs.push_back(succIdx->second);
+        }
+        for (pred_iterator predBlock = pred_begin(basicBlock), E = pred_end(basicBlock); predBlock != E; ++predBlock) {
+            DenseMap<BasicBlock*, unsigned>::iterator predIdx = blockOrderIdx.find(*predBlock);
+            if (predIdx != blockOrderIdx.end())
+                forwardPreds.push_back(predIdx->second);
+        }
+    }
+
+    //IN, OUT and the analysis' auxiliary sets of every block, plus a scratch set
+    unsigned numSets = blockOrder.size() * (2 + Analysis::auxSetsPerBlock) + 1;
+    if (chooseDataFlowRepr(numSets, domain.size()) == DATAFLOW_SPARSE)
+        solve<SparseDataFlowSets>(direction, boundaryCond, initInteriorCond, blockOrder, isBoundary, analysisPredsByBlock, analysisSuccsByBlock, result);
+    else
+        solve<DenseDataFlowSets>(direction, boundaryCond, initInteriorCond, blockOrder, isBoundary, analysisPredsByBlock, analysisSuccsByBlock, result);
+}
+
+template <typename Analysis>
+template <typename Sets>
+void DataFlow<Analysis>::solve(Direction direction, const BitVector& boundaryCond, const BitVector& initInteriorCond,
+                               std::vector<BasicBlock*>& blockOrder, std::vector<bool>& isBoundary,
+                               std::vector<std::vector<int> >& analysisPredsByBlock, std::vector<std::vector<int> >& analysisSuccsByBlock,
+                               DataFlowResult& result) {
+    Analysis* analysis = static_cast<Analysis*>(this);
+    const unsigned setsPerBlock = 2 + Analysis::auxSetsPerBlock;
+    BlockSetsOf<Sets>* blockSets = new BlockSetsOf<Sets>();
+    result.sets.reset(blockSets);
+    result.setsPerBlock = setsPerBlock;
+    blockSets->numBits = boundaryCond.size();
+    Sets& sets = blockSets->sets;
+    sets.init(blockOrder.size() * setsPerBlock + 1, boundaryCond.size());
+    typename Sets::Set transferOut = sets.get(blockOrder.size() * setsPerBlock);
+
+    //Set initial vals: the "IN" of post-entry blocks or the "OUT" of pre-exit blocks get the boundary value
+    //(since entry/exit blocks don't actually exist...), interior blocks start from initInteriorCond
+    std::vector<typename Sets::Set> blockVals(blockOrder.size() * setsPerBlock);
+    for (int idx = 0; idx < blockOrder.size(); idx++) {
+        for (int i = 0; i < setsPerBlock; i++)
+            blockVals[idx * setsPerBlock + i] = sets.get(idx * setsPerBlock + i);
+        Sets::fromBitVector(blockVals[idx * setsPerBlock], isBoundary[idx] ? boundaryCond : initInteriorCond);
+        Sets::assign(blockVals[idx * setsPerBlock + 1], blockVals[idx * setsPerBlock]);
+        analysis->template initBlockSets<Sets>(blockVals.data() + idx * setsPerBlock + 2, blockOrder[idx]);
+    }
+    //IN is set 0 and OUT set 1 of a block; which of them is the analysis input depends on direction
+    const int passInSet = (direction == FORWARD) ? 0 : 1;
+    const int passOutSet = 1 - passInSet;
+
+    //Worklist of block ids, swept round-robin in visiting order: pick the next queued block after the
+    //current one, wrapping around to start a new pass (restarting from the earliest block on every
+    //back edge would re-run the whole loop body for each change).
+    //Every block is visited once, after which only blocks whose inputs changed are re-queued.
+    std::set<int> worklist;
+    for (int idx = 0; idx < blockOrder.size(); idx++)
+        worklist.insert(idx);
+
+    result.iterations = 0;
+    int sweep = 0;
+    while (!worklist.empty()) {
+        std::set<int>::iterator next = worklist.lower_bound(sweep);
+        if (next == worklist.end())
+            next = worklist.begin();
+        int idx = *next;
+        worklist.erase(next);
+        sweep = idx + 1;
+        result.iterations++;
+        BasicBlock* basicBlock = blockOrder[idx];
+        typename Sets::Set passIn = blockVals[idx * setsPerBlock + passInSet];
+        typename Sets::Set passOut = blockVals[idx * setsPerBlock + passOutSet];
+
+        //If any analysis predecessors have outputs ready, meet them into the input set for this block
+        std::vector<int>& preds = analysisPredsByBlock[idx];
+        for (int i = 0; i < preds.size(); i++)
+            analysis->template meetEdge<Sets>(passIn, blockVals[preds[i] * setsPerBlock + passOutSet], blockOrder[preds[i]], basicBlock, i == 0);
+
+        //Apply transfer function to input set in order to get output set for this visit;
+        //if it has changed, this block's analysis successors need to be revisited
+        analysis->template transfer<Sets>(passIn, transferOut, blockVals.data() + idx * setsPerBlock + 2, basicBlock);
+        if (Sets::equal(transferOut, passOut))
+            continue;
+        Sets::assign(passOut, transferOut);
+        for (std::vector<int>::iterator succ = analysisSuccsByBlock[idx].begin(); succ != analysisSuccsByBlock[idx].end(); ++succ)
+            worklist.insert(*succ);
+    }
+}
+
 }  // namespace llvm
 
 #endif
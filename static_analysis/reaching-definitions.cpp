@@ -1,118 +1,227 @@
 #include "reaching-definitions.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 
 namespace llvm {
 
 char ReachingDefinitions::ID = 2;
 static RegisterPass<ReachingDefinitions> B("cd-reaching-definitions", "Reaching Definitions", false, true);
 
+static cl::opt<unsigned> RDCacheSize("rd-cache-size", cl::desc("Number of per-instruction reaching definition sets cached per function (0 disables the cache)"), cl::init(1024));
+static cl::opt<unsigned> RDThreads("rd-threads", cl::desc("Number of threads computing per-function reaching definitions (0 uses one per hardware thread)"), cl::init(0));
+static cl::opt<std::string> RDSummaryFile("rd-summary-file", cl::desc("File the argument redefinition summaries are loaded from and saved to (empty keeps them in memory only)"), cl::init(""));
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 //Dataflow analysis
 
-BitVector ReachingDefinitionsDataFlow::applyMeet(std::vector<BitVector>& meetInputs) {
-    BitVector meetResult;
+ReachingDefinitionsDataFlow::ReachingDefinitionsDataFlow(std::vector<Value*>& domain) : domain(domain), multiVarDefs(domain.size()), killed(domain.size()), candidates(domain.size()) {
+    //Intern the defined variables and record which definitions write each of them
+    std::map<DefinedVar, int> varIds;
+    std::vector<std::vector<int> > writers;
+    definedVars.resize(domain.size());
+    for (int i = 0; i < domain.size(); i++) {
+        domainIdx[domain[i]] = i;
+        std::vector<Value*> def_var;
+        std::vector<std::string> def_field;
+        valueToAllDefinitionVar(domain[i], def_var, def_field);
+        for (int j = 0; j < def_var.size(); j++) {
+            std::map<DefinedVar, int>::iterator varIter = varIds.insert(std::make_pair(std::make_pair(def_var[j], def_field[j]), (int)writers.size())).first;
+            if (varIter->second == writers.size())
+                writers.push_back(std::vector<int>());
+            if (std::find(definedVars[i].begin(), definedVars[i].end(), varIter->second) != definedVars[i].end())
+                continue;
+            definedVars[i].push_back(varIter->second);
+            writers[varIter->second].push_back(i);
+        }
+        if (definedVars[i].size() > 1)
+            multiVarDefs.set(i);
+    }
 
-    //Meet op = union of inputs
-    if (!meetInputs.empty()) {
-        for (int i = 0; i < meetInputs.size(); i++) {
-            if (i == 0)
-                meetResult = meetInputs[i];
-            else
-                meetResult |= meetInputs[i];
+    //A variable written by a single definition never kills anything, so only index the others
+    varDefsIdx.assign(writers.size(), -1);
+    for (int var = 0; var < writers.size(); var++) {
+        if (writers[var].size() < 2)
+            continue;
+        varDefsIdx[var] = varDefs.size();
+        varDefs.push_back(BitVector(domain.size()));
+        for (int j = 0; j < writers[var].size(); j++)
+            varDefs.back().set(writers[var][j]);
+    }
+}
+
+void ReachingDefinitionsDataFlow::collectKills(int defIdx, int pos, RDSweepState& sweep, BitVector& killed) {
+    //Every definition of a written variable is overwritten, unless it also writes other variables
+    killed.reset();
+    candidates.reset();
+    bool hasCandidates = false;
+    for (int j = 0; j < definedVars[defIdx].size(); j++) {
+        int var = definedVars[defIdx][j];
+        sweep.lastWrite[var] = pos;
+        if (varDefsIdx[var] < 0)
+            continue;
+        const BitVector& defs = varDefs[varDefsIdx[var]];
+        killed |= defs;
+        if (defs.anyCommon(multiVarDefs)) {
+            candidates |= defs;
+            hasCandidates = true;
         }
     }
 
-    return meetResult;
+    //Those writing several variables are overwritten once all of them have been written again
+    //since the definition was made (definitions outside this block, or later in it, count from its start)
+    if (hasCandidates) {
+        candidates &= multiVarDefs;
+        for (int i = candidates.find_first(); i != -1; i = candidates.find_next(i)) {
+            DenseMap<int, int>::const_iterator posIter = sweep.defPos.find(i);
+            int since = posIter == sweep.defPos.end() ? -1 : posIter->second;
+            for (int j = 0; j < definedVars[i].size(); j++) {
+                DenseMap<int, int>::const_iterator writeIter = sweep.lastWrite.find(definedVars[i][j]);
+                if (writeIter == sweep.lastWrite.end() || writeIter->second <= since) {
+                    killed.reset(i);
+                    break;
+                }
+            }
+        }
+    }
+    killed.reset(defIdx);
+    sweep.defPos[defIdx] = pos;
 }
 
-TransferResult ReachingDefinitionsDataFlow::applyTransfer(const BitVector& value, DenseMap<Value*, int>& domainEntryToValueIdx, BasicBlock* block) {
-    TransferResult transfer;
+void ReachingDefinitionsDataFlow::applyInstruction(Instruction* I, int pos, BitVector& value, RDSweepState& sweep) {
+    DenseMap<Value*, int>::const_iterator currDefIter = domainIdx.find(I);
+    if (currDefIter == domainIdx.end())
+        return;
+    collectKills(currDefIter->second, pos, sweep, killed);
+    value.reset(killed);
+    value.set(currDefIter->second);
+}
 
-    //First, calculate the set of downwards exposed definition generations and the set of killed definitions in this block
-    int domainSize = domainEntryToValueIdx.size();
-    BitVector genSet(domainSize);
-    BitVector killSet(domainSize);
+const BlockRDSummary& ReachingDefinitionsDataFlow::getBlockSummary(BasicBlock* block) {
+    DenseMap<BasicBlock*, BlockRDSummary>::iterator summaryIter = blockSummaries.find(block);
+    if (summaryIter != blockSummaries.end())
+        return summaryIter->second;
 
+    //Sweep the block once: killed definitions leave the gen set, new ones enter it
+    BlockRDSummary summary;
+    summary.gen.resize(domain.size());
+    summary.kill.resize(domain.size());
+    RDSweepState sweep;
     int instr_cnt = 0;
     for (BasicBlock::iterator instruction = block->begin(); instruction != block->end(); ++instruction, instr_cnt++) {
-        //std::string instr = valueToStr(&*instruction);
-        //if (instr.find("  call void @llvm.dbg.declare") == 0) continue;
-        DenseMap<Value*, int>::const_iterator currDefIter = domainEntryToValueIdx.find(&*instruction);
-        if (currDefIter != domainEntryToValueIdx.end()) {
-            //          errs() << "applyTransfer " << instr << "\n";
-            //Kill prior definitions for the same variable (including those in this block's gen set)
-            std::map<Value*, std::map<Value*, std::set<std::string> > > def_set;
-            getBBReachDef(domainEntryToValueIdx, block, instr_cnt, def_set);
-            for (DenseMap<Value*, int>::const_iterator prevDefIter = domainEntryToValueIdx.begin();
-                 prevDefIter != domainEntryToValueIdx.end();
-                 ++prevDefIter) {
-                if (def_set.find(prevDefIter->first) == def_set.end()) {
-                    killSet.set(prevDefIter->second);
-                    genSet.reset(prevDefIter->second);
-                }
-            }
-
-            //Add this new definition to gen set (note that we might later remove it if another def in this block kills it)
-            genSet.set((*currDefIter).second);
-        }
+        DenseMap<Value*, int>::const_iterator currDefIter = domainIdx.find(&*instruction);
+        if (currDefIter == domainIdx.end())
+            continue;
+        collectKills(currDefIter->second, instr_cnt, sweep, killed);
+        summary.kill |= killed;
+        summary.gen.reset(killed);
+        summary.gen.set(currDefIter->second);
     }
+    return blockSummaries[block] = std::move(summary);
+}
 
-    //Then, apply transfer function: Y = GenSet \union (X - KillSet)
-    transfer.baseValue = killSet;
-    transfer.baseValue.flip();
-    transfer.baseValue &= value;
-    transfer.baseValue |= genSet;
+FunctionReachingDefs::FunctionReachingDefs(Function& F, std::vector<Value*>& entries, std::set<BasicBlock*>& prune_bb, unsigned cacheSize)
+    : domain(std::move(entries)), flow(domain), cacheSize(cacheSize) {
+    int numVars = domain.size();
 
-    return transfer;
+    //Set the initial boundary dataflow value to be the set of input argument definitions for this function
+    BitVector boundaryCond(numVars, false);
+    for (int i = 0; i < domain.size(); i++)
+        if (isa<Argument>(domain[i]))
+            boundaryCond.set(i);
+
+    //Set interior initial dataflow values to be empty sets
+    BitVector initInteriorCond(numVars, false);
+
+    flow.run(F, domain, DataFlowBase::FORWARD, boundaryCond, initInteriorCond, prune_bb, dataFlowResult);
+
+    for (int i = 0; i < domain.size(); i++) {
+        Value* defVar = valueToDefVar(domain[i]);
+        if (defVar)
+            defsByVar[defVar].push_back(i);
+    }
 }
 
-//Find reaching defintions of operands
-void ReachingDefinitions::getOperandDefVals(Instruction* inst, std::map<Value*, std::vector<Value*> >& reaching_def_instr, std::map<Value*, BasicBlock*>& instr_bb_map, std::map<BasicBlock*, std::string>& bb_name_map, std::map<Value*, int>& instr_id_map) {
-    for (int i = 0; i < inst->getNumOperands(); i++) {
-        Value* val = inst->getOperand(i);
-        if (!isa<Argument>(val) && !isa<Instruction>(val))
-            continue;
-        for (int j = 0; j < reaching_def_instr[inst].size(); j++) {
-            std::vector<Value*> def_var;
-            std::vector<std::string> def_field;
-            valueToAllDefinitionVar(reaching_def_instr[inst][j], def_var, def_field);
-            for (int k = 0; k < def_var.size(); k++)
-                if (def_var[k] == val) {}
-                    // curr_instr-operand,bb,line : rd-bb,line
-                    // errs() << "Reaching Defs (" << i << "," << bb_name_map[instr_bb_map[inst]] << "," << instr_id_map[inst] << ") : " << bb_name_map[instr_bb_map[reaching_def_instr[inst][j]]] << "," << instr_id_map[reaching_def_instr[inst][j]] << def_field[k] << "\n";
-            //errs() << "Reaching Defs (" << i << "," << bb_name_map[instr_bb_map[inst]] << "," << instr_id_map[inst] << ") : " << bb_name_map[instr_bb_map[reaching_def_instr[inst][j]]] << "," << instr_id_map[reaching_def_instr[inst][j]] << "\n";
+bool FunctionReachingDefs::hasReachingDefs(Instruction* I) {
+    //(phi nodes aren't "real" instructions)
+    return !isa<PHINode>(I) && dataFlowResult.hasBlock(I->getParent());
+}
+
+const BitVector& FunctionReachingDefs::getReachingDefs(Instruction* I) {
+    BitVector* reachingDefVals = &scratch;
+    if (cacheSize > 0) {
+        DenseMap<Instruction*, CacheList::iterator>::iterator cacheIter = cacheIndex.find(I);
+        if (cacheIter != cacheIndex.end()) {
+            cache.splice(cache.begin(), cache, cacheIter->second);
+            return cacheIter->second->second;
         }
+        if (cache.size() >= cacheSize) {
+            cacheIndex.erase(cache.back().first);
+            cache.pop_back();
+        }
+        cache.push_front(std::make_pair(I, BitVector()));
+        cacheIndex[I] = cache.begin();
+        reachingDefVals = &cache.front().second;
+    }
+
+    //Iterate forward from the IN point of the block up to the program point just past I
+    BasicBlock* block = I->getParent();
+    dataFlowResult.getIn(block, *reachingDefVals);
+    RDSweepState sweep;
+    int instr_cnt = 0;
+    for (BasicBlock::iterator instruction = block->begin(); instruction != block->end(); ++instruction, instr_cnt++) {
+        flow.applyInstruction(&*instruction, instr_cnt, *reachingDefVals, sweep);
+        if (&*instruction == I)
+            break;
     }
+    return *reachingDefVals;
 }
 
-bool ReachingDefinitions::runOnFunction(Function& F) {
+void FunctionReachingDefs::getDefinitionsOf(Instruction* I, Value* V, std::vector<Value*>& defs) {
+    DenseMap<Value*, SmallVector<int, 1> >::iterator varIter = defsByVar.find(V);
+    if (varIter == defsByVar.end())
+        return;
+    const BitVector& reachingDefVals = getReachingDefs(I);
+    for (int i = 0; i < varIter->second.size(); i++)
+        if (reachingDefVals[varIter->second[i]])
+            defs.push_back(domain[varIter->second[i]]);
+}
+
+bool ReachingDefinitions::isTargetFunction(Function& F) {
     if (F.isDeclaration())
         return false;
     std::string func_name = demangle(F.getName().str().c_str());
     // if (TargetFunc.find(func_name) == TargetFunc.end())
     //     return;
-    if (TargetFunc.find(func_name) == TargetFunc.end())
+    return TargetFunc.find(func_name) != TargetFunc.end();
+}
+
+bool ReachingDefinitions::runOnFunction(Function& F) {
+    if (!isTargetFunction(F))
         return false;
+    FunctionRDOutput out;
+    analyzeFunction(F, out);
+    getFuncRDSummaries().set(&F, out.redefs);
+    mergeFunction(out);
+    return false;
+}
+
+void ReachingDefinitions::analyzeFunction(Function& F, FunctionRDOutput& out) {
+    std::string func_name = demangle(F.getName().str().c_str());
+    raw_string_ostream log(out.log);
 
     // errs() << "Found func " << func_name << "\n";
 
     std::set<BasicBlock*> prune_bb;
     struct timeval start, end;
-    std::map<Value*, BasicBlock*> instr_bb_map;
-    std::map<BasicBlock*, std::string> bb_name_map;
-    std::map<Value*, int> instr_id_map;
+    out.F = &F;
 
     //Set domain as a vector of definitions instr in the function
     std::vector<Value*> domain;
-    int arg_idx = 0;
-    bb_name_map[NULL] = "arg";
     for (Function::arg_iterator arg = F.arg_begin(); arg != F.arg_end(); ++arg) {
         domain.push_back(arg);
-        instr_id_map[&*arg] = arg_idx;
-        instr_bb_map[&*arg] = NULL;
-        arg_idx++;
     }
     for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock)
         if ((&*basicBlock) != &(F.getEntryBlock()) && pred_begin(&*basicBlock) == pred_end(&*basicBlock))
@@ -133,8 +242,6 @@ bool ReachingDefinitions::runOnFunction(Function& F) {
     for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
         if (prune_bb.find(&*basicBlock) != prune_bb.end())
             continue;
-        bb_name_map[&*basicBlock] = basicBlock->getName();
-        int instr_idx = 0;
         gettimeofday(&start, NULL);
         int curr_size = domain.size();
         for (BasicBlock::iterator instruction = basicBlock->begin(); instruction != basicBlock->end(); ++instruction) {
@@ -144,131 +251,74 @@ bool ReachingDefinitions::runOnFunction(Function& F) {
             if (def_var.size() > 0) {
                 domain.push_back(&*instruction);
             }
-            instr_id_map[&*instruction] = instr_idx;
-            instr_bb_map[&*instruction] = &*basicBlock;
-            instr_idx++;
         }
         gettimeofday(&end, NULL);
-        // errs() << "Found BB " << bb_name_map[&*basicBlock] << " " << ((end.tv_sec * 1000000 + end.tv_usec) - (start.tv_sec * 1000000 + start.tv_usec)) << " " << (domain.size() - curr_size) << "\n";
+        // errs() << "Found BB " << basicBlock->getName() << " " << ((end.tv_sec * 1000000 + end.tv_usec) - (start.tv_sec * 1000000 + start.tv_usec)) << " " << (domain.size() - curr_size) << "\n";
     }
-    int numVars = domain.size();
 
-    // errs() << "Found func " << func_name << " " << numVars << "\n";
+    //Get dataflow values at IN and OUT points of each block; reaching definitions at program points
+    //within the blocks are extended from those on demand
+    FunctionReachingDefs* reachingDefs = new FunctionReachingDefs(F, domain, prune_bb, RDCacheSize);
+    out.reachingDefs.reset(reachingDefs);
 
-    //List of reaching definitions at an instruction
-    std::map<Value*, std::vector<Value*> > reaching_def_instr;
-
-    //Set the initial boundary dataflow value to be the set of input argument definitions for this function
-    BitVector boundaryCond(numVars, false);
-    for (int i = 0; i < domain.size(); i++)
-        if (isa<Argument>(domain[i]))
-            boundaryCond.set(i);
-
-    //Set interior initial dataflow values to be empty sets
-    BitVector initInteriorCond(numVars, false);
-
-    //Get dataflow values at IN and OUT points of each block
-    ReachingDefinitionsDataFlow flow;
-    DataFlowResult dataFlowResult = flow.run(F, domain, DataFlow::FORWARD, boundaryCond, initInteriorCond, prune_bb);
-
-    //Then, extend those values into the interior points of each block, outputting the result along the way
-    errs() << "* REACHING DEFINITIONS OUTPUT FOR FUNCTION: " << func_name << " \n";
+    log << "* REACHING DEFINITIONS OUTPUT FOR FUNCTION: " << func_name << " \n";
     //    errs() << "Domain of values: " << setToStr(domain, BitVector(domain.size(), true), valueToDefinitionStr) << "\n";
     //    errs() << "Variables: "   << setToStr(domain, BitVector(domain.size(), true), valueToDefinitionVarStr) << "\n";
+    getFuncRedef(F, reachingDefs->domain, reachingDefs->dataFlowResult, out.redefs, log);
+    log << "* END REACHING DEFINITION OUTPUT FOR FUNCTION: " << func_name << "\n";
+    log.flush();
+}
 
-    //Print function header (in hacky way... look for "definition" keyword in full printed function, then print rest of that line only)
-    //    std::string funcStr = valueToStr(&F);
-    //    int funcHeaderStartIdx = funcStr.find("define");
-    //    int funcHeaderEndIdx = funcStr.find('{', funcHeaderStartIdx + 1);
-    //    errs() << funcStr.substr(funcHeaderStartIdx, funcHeaderEndIdx-funcHeaderStartIdx) << "\n";
-
-    //Now, use dataflow results to output reaching definitions at program points within each block
-    for (Function::iterator basicBlock = F.begin(); basicBlock != F.end(); ++basicBlock) {
-        if (prune_bb.find(&*basicBlock) != prune_bb.end()) continue;
-        DataFlowResultForBlock blockReachingDefVals = dataFlowResult.resultsByBlock[&*basicBlock];
-
-        //Print just the header line of the block (in a hacky way... blocks start w/ newline, so look for first occurrence of newline beyond first char
-        //      std::string basicBlockStr = valueToStr(basicBlock);
-        //      errs() << basicBlockStr.substr(0, basicBlockStr.find(':', 1) + 1) << "\n";
-
-        //Initialize reaching definitions at the start of the block
-        BitVector reachingDefVals = blockReachingDefVals.in;
-
-        std::vector<std::string> blockOutputLines;
-
-        //Output reaching definitions at the IN point of this block (not strictly needed, but useful to see)
-        //      blockOutputLines.push_back("\nReaching Defs (BB IN): " + setToStr(domain, reachingDefVals, valueToDefinitionStr) + "\n");
-
-        //Iterate forward through instructions of the block, updating and outputting reaching defs
-        int instr_cnt = 0;
-        for (BasicBlock::iterator instruction = basicBlock->begin(); instruction != basicBlock->end(); ++instruction, instr_cnt++) {
-            //Output the instruction contents
-            //blockOutputLines.push_back(valueToStr(&*instruction));
-
-            //        std::string instr = valueToStr(&*instruction);
-            //        if (instr.find("  call void @llvm.dbg") == 0) continue;
-
-            DenseMap<Value*, int>::const_iterator defIter;
-
-            Value* currDefStr = valueToDefinitionVar(&*instruction);  //std::string currDefStr = valueToDefinitionVarStr(instruction);
-
-            //Kill (unset) all existing defs for this variable
-            std::map<Value*, std::map<Value*, std::set<std::string> > > def_set;
-            getBBReachDef(dataFlowResult.domainEntryToValueIdx, &*basicBlock, instr_cnt, def_set);
-            for (defIter = dataFlowResult.domainEntryToValueIdx.begin(); defIter != dataFlowResult.domainEntryToValueIdx.end(); ++defIter) {
-                if (def_set.find(defIter->first) == def_set.end())
-                    reachingDefVals.reset(defIter->second);
-            }
+void ReachingDefinitions::mergeFunction(FunctionRDOutput& out) {
+    func_reaching_def[out.F] = std::move(out.reachingDefs);
+    errs() << out.log;
+}
 
-            //Add this definition to the reaching set
-            defIter = dataFlowResult.domainEntryToValueIdx.find(&*instruction);
-            if (defIter != dataFlowResult.domainEntryToValueIdx.end())
-                reachingDefVals.set((*defIter).second);
-
-            //Output the set of reaching definitions at program point just past instruction
-            //(but only if not a phi node... those aren't "real" instructions)
-            if (!isa<PHINode>(instruction)) {
-                reaching_def_instr[&*instruction] = std::vector<Value*>();
-                for (int i = 0; i < domain.size(); i++)
-                    if (reachingDefVals[i])
-                        reaching_def_instr[&*instruction].push_back(domain[i]);
-                //          errs() << "Curr instr: " << valueToStr(&*instruction) << "\n";
-                getOperandDefVals(&*instruction, reaching_def_instr, instr_bb_map, bb_name_map, instr_id_map);
-                //Debugging output
-                //for (int i = 0; i < reaching_def_instr[&*instruction].size(); i++)
-                //     errs() << "Reaching Defs: " << valueToStr(reaching_def_instr[&*instruction][i]) << "\n";
-                //          blockOutputLines.push_back("\nReaching Defs (" + valueToStr(&*instruction) + ", " + std::to_string(reaching_def_instr[&*instruction].size()) + "): " + setToStr(domain, reachingDefVals, valueToDefinitionStr) + "\n");
+bool ReachingDefinitions::runOnModule(Module &M) {
+    // Callees before callers, so that calls see the summaries of the functions they invoke.
+    // A target function goes one wave after the last wave of the target functions it calls (and
+    // after the members of its SCC visited before it), so functions of one wave are independent.
+    CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+    std::vector<Function*> order;
+    DenseMap<Function*, unsigned> funcWave;
+    std::vector<std::vector<int> > waves;
+    for (scc_iterator<CallGraph*> SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC) {
+        unsigned wave = 0;
+        for (CallGraphNode *N : *SCC) {
+            for (CallGraphNode::iterator CR = N->begin(); CR != N->end(); ++CR) {
+                DenseMap<Function*, unsigned>::iterator it = funcWave.find(CR->second->getFunction());
+                if (it != funcWave.end())
+                    wave = std::max(wave, it->second + 1);
             }
         }
-
-        //Debugging output
-        //for (std::vector<std::string>::iterator i = blockOutputLines.begin(); i < blockOutputLines.end(); ++i)
-        //  errs() << *i << "\n";
+        for (CallGraphNode *N : *SCC) {
+            Function *F = N->getFunction();
+            if (F == NULL || !isTargetFunction(*F))
+                continue;
+            funcWave[F] = wave;
+            if (waves.size() <= wave)
+                waves.resize(wave + 1);
+            waves[wave].push_back(order.size());
+            order.push_back(F);
+            wave++;
+        }
     }
-    getFuncRedef(F, domain, dataFlowResult);
-    errs() << "* END REACHING DEFINITION OUTPUT FOR FUNCTION: " << func_name << "\n";
 
-    for (std::map<Value*, std::vector<Value*> >::iterator it = reaching_def_instr.begin(); it != reaching_def_instr.end(); it++) {
-        func_reaching_def[func_name][it->first] = std::vector<Value*>();
-        for (int i = 0; i < it->second.size(); i++)
-            func_reaching_def[func_name][it->first].push_back((it->second)[i]);
+    std::vector<FunctionRDOutput> outputs(order.size());
+    for (int w = 0; w < waves.size(); w++) {
+        std::vector<int>& wave = waves[w];
+        parallelForEach(RDThreads, wave.size(), [&](size_t i) {
+            analyzeFunction(*order[wave[i]], outputs[wave[i]]);
+        });
+        for (int i = 0; i < wave.size(); i++)
+            getFuncRDSummaries().set(order[wave[i]], outputs[wave[i]].redefs);
     }
-    for (std::map<Value*, BasicBlock*>::iterator it = instr_bb_map.begin(); it != instr_bb_map.end(); it++)
-        func_instr_bb_map[func_name][it->first] = it->second;
-    for (std::map<BasicBlock*, std::string>::iterator it = bb_name_map.begin(); it != bb_name_map.end(); it++)
-        func_bb_name_map[func_name][it->first] = it->second;
-    for (std::map<Value*, int>::iterator it = instr_id_map.begin(); it != instr_id_map.end(); it++)
-        func_instr_id_map[func_name][it->first] = it->second;
-
+    // Merge in call graph order to keep the output independent of the thread count
+    for (int i = 0; i < outputs.size(); i++)
+        mergeFunction(outputs[i]);
     return false;
 }
 
-bool ReachingDefinitions::runOnModule(Module &M) {
-    for (Function &F: M) {
-        runOnFunction(F);
-    }
-}
-
 bool ReachingDefinitions::doInitialization(Module& M) {
     //record the function name
     std::string configPath = "";
@@ -283,10 +333,14 @@ bool ReachingDefinitions::doInitialization(Module& M) {
             TargetFunc.insert(func);
         infile.close();
     }
+    if (RDSummaryFile != "")
+        getFuncRDSummaries().load(M, RDSummaryFile);
     return false;
 }
 
 bool ReachingDefinitions::doFinalization(Module& M) {
+    if (RDSummaryFile != "" && !getFuncRDSummaries().save(RDSummaryFile))
+        errs() << "Failed to write reaching definition summaries to " << RDSummaryFile << "\n";
     return false;
 }
 
@@ -1,12 +1,17 @@
 #ifndef __REACHING_DEFINITIONS__
 #define __REACHING_DEFINITIONS__
 
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <fstream>
+#include <list>
+#include <map>
+#include <memory>
 #include "dataflow.h"
 #include "utils.h"
 
@@ -19,41 +24,157 @@ namespace llvm {
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 //Dataflow analysis
-class ReachingDefinitionsDataFlow : public DataFlow {
+
+/** A variable written by a definition, with the field path (possibly empty) below it */
+typedef std::pair<Value*, std::string> DefinedVar;
+
+/** Downwards exposed definitions (gen) and definitions overwritten (kill) by a basic block */
+struct BlockRDSummary {
+    BitVector gen;
+    BitVector kill;
+};
+
+/** State of a forward sweep through a single basic block.
+ * defPos: position of each definition (domain index) met so far in the block
+ * lastWrite: last position in the block at which each defined variable (by id) was written */
+struct RDSweepState {
+    DenseMap<int, int> defPos;
+    DenseMap<int, int> lastWrite;
+};
+
+class ReachingDefinitionsDataFlow : public DataFlow<ReachingDefinitionsDataFlow> {
+    friend class DataFlow<ReachingDefinitionsDataFlow>;
+
+   public:
+    ReachingDefinitionsDataFlow(std::vector<Value*>& domain);
+
+    /** Applies the definition made by the instruction at position pos of its block (if any) to value.
+     * Instructions of a block must be fed in order, sharing one sweep state. */
+    void applyInstruction(Instruction* I, int pos, BitVector& value, RDSweepState& sweep);
+
+    /** Gen/kill summary of a block, computed on first use and cached until the solver copies it into its sets */
+    const BlockRDSummary& getBlockSummary(BasicBlock* block);
+
+    // gen and kill sets of each block
+    static const unsigned auxSetsPerBlock = 2;
+
    protected:
-    BitVector applyMeet(std::vector<BitVector>& meetInputs);
+    template <typename Sets>
+    void initBlockSets(typename Sets::Set* aux, BasicBlock* block) {
+        const BlockRDSummary& summary = getBlockSummary(block);
+        Sets::fromBitVector(aux[0], summary.gen);
+        Sets::fromBitVector(aux[1], summary.kill);
+        //The solver's sets are now the only copy kept
+        blockSummaries.erase(block);
+    }
+
+    //Meet op = union of inputs
+    template <typename Sets>
+    void meet(typename Sets::Set acc, typename Sets::Set input) {
+        Sets::unite(acc, input);
+    }
 
-    TransferResult applyTransfer(const BitVector& value, DenseMap<Value*, int>& domainEntryToValueIdx, BasicBlock* block);
+    //Apply transfer function: Y = GenSet \union (X - KillSet)
+    template <typename Sets>
+    void transfer(typename Sets::Set in, typename Sets::Set out, typename Sets::Set* aux, BasicBlock* block) {
+        Sets::genKill(out, in, aux[0], aux[1]);
+    }
+
+   private:
+    std::vector<Value*>& domain;
+    DenseMap<Value*, int> domainIdx;
+    // ids of the variables written by each domain entry, as given by valueToAllDefinitionVar
+    std::vector<SmallVector<int, 1> > definedVars;
+    // var id => index into varDefs, or -1 if the variable is written by a single definition
+    std::vector<int> varDefsIdx;
+    // definitions writing each variable that is written by more than one definition
+    std::vector<BitVector> varDefs;
+    // definitions writing more than one variable
+    BitVector multiVarDefs;
+    DenseMap<BasicBlock*, BlockRDSummary> blockSummaries;
+    BitVector killed;
+    BitVector candidates;
+
+    /** Sets in killed the definitions overwritten by domain entry defIdx, met at position pos of the swept block.
+     * A definition is overwritten once all the variables it writes have been written again since it was made. */
+    void collectKills(int defIdx, int pos, RDSweepState& sweep, BitVector& killed);
 };
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+/** Reaching definitions of a function. Only the IN and OUT sets of each block are kept;
+ * the definitions reaching a program point are extended from the IN set of its block on demand,
+ * with the most recently queried instructions kept in a LRU cache. */
+class FunctionReachingDefs {
+   public:
+    std::vector<Value*> domain;
+    DataFlowResult dataFlowResult;
+
+    FunctionReachingDefs(Function& F, std::vector<Value*>& entries, std::set<BasicBlock*>& prune_bb, unsigned cacheSize);
+
+    /** Whether reaching definitions are known at I (a non-phi instruction in a reachable block) */
+    bool hasReachingDefs(Instruction* I);
+
+    /** Definitions (as domain indices) reaching the program point just past I.
+     * The result is only valid until the next query. */
+    const BitVector& getReachingDefs(Instruction* I);
+
+    /** Appends to defs the definitions of V (as given by valueToDefVar) reaching the program point just past I */
+    void getDefinitionsOf(Instruction* I, Value* V, std::vector<Value*>& defs);
+
+   private:
+    typedef std::list<std::pair<Instruction*, BitVector> > CacheList;
+
+    ReachingDefinitionsDataFlow flow;
+    // defined var => definitions (as domain indices)
+    DenseMap<Value*, SmallVector<int, 1> > defsByVar;
+    unsigned cacheSize;
+    CacheList cache;
+    DenseMap<Instruction*, CacheList::iterator> cacheIndex;
+    BitVector scratch;
+};
+
+/** Everything computed for one function by ReachingDefinitions. Filled in independently for each
+ * function (possibly on a worker thread) and merged into func_reaching_def afterwards. */
+struct FunctionRDOutput {
+    Function* F;
+    std::unique_ptr<FunctionReachingDefs> reachingDefs;
+    ArgRedefs redefs;
+    // Buffered errs() output
+    std::string log;
+};
+
 class ReachingDefinitions : public ModulePass {
    public:
     static char ID;
     std::set<std::string> TargetFunc;
 
-    std::map<std::string, std::map<Value*, std::vector<Value*> > > func_reaching_def;
-    std::map<std::string, std::map<Value*, BasicBlock*> > func_instr_bb_map;
-    std::map<std::string, std::map<BasicBlock*, std::string> > func_bb_name_map;
-    std::map<std::string, std::map<Value*, int> > func_instr_id_map;
+    DenseMap<const Function*, std::unique_ptr<FunctionReachingDefs> > func_reaching_def;
 
     ReachingDefinitions() : ModulePass(ID) {}
 
-    //Find reaching defintions of operands
-    void getOperandDefVals(Instruction* inst, std::map<Value*, std::vector<Value*> >& reaching_def_instr, std::map<Value*, BasicBlock*>& instr_bb_map, std::map<BasicBlock*, std::string>& bb_name_map, std::map<Value*, int>& instr_id_map);
+    /** Reaching definitions of F, or null if F was not analyzed */
+    FunctionReachingDefs* getFunctionReachingDefs(const Function* F) const {
+        DenseMap<const Function*, std::unique_ptr<FunctionReachingDefs> >::const_iterator it = func_reaching_def.find(F);
+        return it == func_reaching_def.end() ? NULL : it->second.get();
+    }
 
     virtual bool doInitialization(Module& M);
 
     virtual bool doFinalization(Module& M);
 
+    bool isTargetFunction(Function& F);
     bool runOnFunction(Function& F);
     bool runOnModule(Module& M);
 
     virtual void getAnalysisUsage(AnalysisUsage& AU) const {
+        AU.addRequired<CallGraphWrapperPass>();
         AU.setPreservesAll();
     }
 
    private:
+    /** Only reads the pass state and the callee summaries, so functions can be analyzed concurrently */
+    void analyzeFunction(Function& F, FunctionRDOutput& out);
+    void mergeFunction(FunctionRDOutput& out);
 };
 
 }  // namespace llvm
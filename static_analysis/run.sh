@@ -1,5 +1,12 @@
 DEFAULT_BITCODE=${DEFAULT_BITCODE:-"test/apollo/apollo5.5.bc"}
 USE_DEFAULT=${USE_DEFAULT:-true}
+RD_CACHE_SIZE=${RD_CACHE_SIZE:-1024}
+RD_SUMMARY_FILE=${RD_SUMMARY_FILE:-""}
+RD_THREADS=${RD_THREADS:-0}
+DATAFLOW_REPR=${DATAFLOW_REPR:-auto}
+CD_THREADS=${CD_THREADS:-0}
+USE_DRIVER=${USE_DRIVER:-false}
+CALLEE_REGISTRY=${CALLEE_REGISTRY:-callees.txt}
 
 if [ "${1}" = ""  ]; then
     echo "Input an argumet as the target test case"
@@ -25,4 +32,9 @@ if [ "$USE_DEFAULT" = false ]; then
 fi
 
 echo ${1} > config.tmp
-opt -load ./traffic-rule-info.so -traffic-rule-info ${bitcode} -o /dev/null
+options="-rd-cache-size=${RD_CACHE_SIZE} -rd-summary-file=${RD_SUMMARY_FILE} -rd-threads=${RD_THREADS} -dataflow-repr=${DATAFLOW_REPR} -cd-threads=${CD_THREADS} -callee-registry=${CALLEE_REGISTRY}"
+if [ "$USE_DRIVER" = true ]; then
+    ./traffic-rule-driver ${bitcode} ${options}
+else
+    opt -load ./traffic-rule-info.so -traffic-rule-info ${options} ${bitcode} -o /dev/null
+fi
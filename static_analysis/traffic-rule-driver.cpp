@@ -0,0 +1,117 @@
+// Runs traffic-rule-info (with the analyses it requires) on a bitcode file without materializing the whole module:
+// only the functions named in func.meta/sink.meta/source.meta of the test directory in config.tmp, and the
+// functions they call directly, get their bodies loaded; every other function is turned into a declaration.
+// Usage: ./traffic-rule-driver <bitcode> [any -rd-*/-cd-*/-dataflow-* option]
+////////////////////////////////////////////////////////////////////////////////
+
+#include "traffic-rule-info.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/resource.h>
+
+#include <fstream>
+#include <set>
+#include <string>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input bitcode>"), cl::Required);
+
+/** Adds the lines of configPath/fileName to names */
+static void readMeta(const std::string& configPath, const std::string& fileName, std::set<std::string>& names) {
+    std::ifstream file(configPath + "/" + fileName);
+    std::string name;
+    while (std::getline(file, name))
+        names.insert(name);
+}
+
+static bool materialize(Function* F) {
+    if (!F->isMaterializable())
+        return true;
+    if (Error E = F->materialize()) {
+        logAllUnhandledErrors(std::move(E), errs(), "Failed to load " + F->getName().str() + ": ");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    cl::ParseCommandLineOptions(argc, argv, "traffic rule extraction on the functions of the target only\n");
+
+    PassRegistry& Registry = *PassRegistry::getPassRegistry();
+    initializeCore(Registry);
+    initializeAnalysis(Registry);
+
+    //Same lookup as the passes: config.tmp names the test directory
+    std::string configPath = "";
+    std::ifstream configFile("config.tmp");
+    if (configFile.is_open())
+        std::getline(configFile, configPath);
+    std::set<std::string> targets;
+    readMeta(configPath, "func.meta", targets);
+    readMeta(configPath, "sink.meta", targets);
+    readMeta(configPath, "source.meta", targets);
+
+    LLVMContext C;
+    SMDiagnostic Err;
+    std::unique_ptr<Module> M = getLazyIRFileModule(InputFilename, Err, C);
+    if (!M) {
+        Err.print(argv[0], errs());
+        return 1;
+    }
+
+    //Bodies of the target functions, then of their direct callees
+    std::vector<Function*> loaded;
+    for (Function& F : *M) {
+        if (targets.find(demangle(F.getName().str().c_str())) == targets.end() || !F.isMaterializable())
+            continue;
+        if (!materialize(&F))
+            return 1;
+        loaded.push_back(&F);
+    }
+    unsigned numTargets = loaded.size();
+    for (unsigned i = 0; i < numTargets; i++) {
+        for (BasicBlock& BB : *loaded[i]) {
+            for (Instruction& I : BB) {
+                if (!isa<CallBase>(&I))
+                    continue;
+                Function* callee = getCalledFunction(dyn_cast<CallBase>(&I));
+                if (callee == nullptr || !callee->isMaterializable())
+                    continue;
+                if (!materialize(callee))
+                    return 1;
+                loaded.push_back(callee);
+            }
+        }
+    }
+
+    //Everything else becomes a declaration, so the module can be marked fully materialized
+    unsigned numFuncs = 0;
+    for (Function& F : *M) {
+        numFuncs++;
+        if (F.isMaterializable())
+            F.deleteBody();
+    }
+    if (Error E = M->materializeAll()) {
+        logAllUnhandledErrors(std::move(E), errs(), "Failed to load " + InputFilename + ": ");
+        return 1;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    errs() << "Loaded " << loaded.size() << " of " << numFuncs << " functions (" << numTargets << " targets), peak RSS " << usage.ru_maxrss << " KB\n";
+
+    legacy::PassManager PM;
+    PM.add(new TrafficRuleInfo());
+    PM.run(*M);
+    return 0;
+}
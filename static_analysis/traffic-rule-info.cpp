@@ -34,7 +34,7 @@ namespace llvm {
 void VectorStatus::setSource(Value *vec, bool status) {
     // errs() << "set source " << *vec << " " << std::to_string(status) << "\n";
     vectorSources.insert(vec);
-    vectorStatus[vec] = status;
+    setStatus(vec, status);
     vectorTaints[vec] = std::set<Value *>();
     vectorTaints[vec].insert(dyn_cast<Instruction>(vec));
 }
@@ -80,7 +80,14 @@ bool VectorStatus::getStatus(Value *vec) {
 
 void VectorStatus::setStatus(Value *vec, bool status) {
     // errs() << "set status " << *vec << " " << status << "\n";
-    vectorStatus[vec] = status;
+    auto it = vectorStatus.find(vec);
+    if (it != vectorStatus.end()) {
+        statusHash ^= hash_combine(vec, it->second);
+        it->second = status;
+    } else {
+        vectorStatus[vec] = status;
+    }
+    statusHash ^= hash_combine(vec, status);
 }
 
 std::string TrafficRuleInfo::getVarName(Value *V, ControlDependency &CD) {
@@ -104,7 +111,7 @@ std::string TrafficRuleInfo::getVarName(Value *V, ControlDependency &CD) {
                 // TODO: how to accurately recognize class functions?
                 if (v_type_name.find("apollo") != std::string::npos) {
                     Value *I = dyn_cast<Value>(II->getOperand(0));
-                    auto defs = CD.getDefinitions(II->getParent()->getParent(), II, I);
+                    const auto &defs = CD.getDefinitions(II->getParent()->getParent(), II, I);
                     // cannot resolve multiple definitions
                     if (defs.size() == 1) {
                         if (globalVars.find(*(defs.begin())) != globalVars.end()) {
@@ -125,7 +132,7 @@ std::string TrafficRuleInfo::getVarName(Value *V, ControlDependency &CD) {
         name = II->getName();
         std::string prefix = "";
         Value *I = dyn_cast<Value>(II->getOperand(0));
-        auto defs = CD.getDefinitions(II->getParent()->getParent(), II, I);
+        const auto &defs = CD.getDefinitions(II->getParent()->getParent(), II, I);
         // cannot resolve multiple definitions
         if (defs.size() == 1) {
             if (globalVars.find(*(defs.begin())) != globalVars.end()) {
@@ -170,34 +177,60 @@ bool TrafficRuleInfo::runOnFunction(Function &F, ControlDependency &CD, z3::cont
     if (CD.MCFG.find(&F) == CD.MCFG.end())
         return false;
 
+    // every function is extracted once per run; its callers instantiate its summary
+    if (funcPaths.find(&F) != funcPaths.end() || analyzing.find(&F) != analyzing.end())
+        return false;
+    analyzing.insert(&F);
+    // the callees analyzed from here (for their summaries) nest their own scopes
+    feasibility->push();
+
     LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
     DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>(F).getDomTree();
 
     errs() << "Extracting paths in Function " << demangle(F.getName().str().c_str()) << "\n";
 
-    funcPaths[&F] = std::vector<Path>();
-    Path initPath = Path(&F, c);
+    PathBuckets live;
+    Path initPath = Path(&F, exprs, c);
     // init vector status
     std::set<Value *> vectors;
     for (auto s : CD.VectorSources[&F]) {
         initPath.vectorStatus.setSource(s.first, s.second);
     }
     // set init path
-    funcPaths[&F].push_back(initPath);
+    live[initPath.next].push_back(initPath);
 
     // init parameters
     for (auto arg = F.arg_begin(); arg != F.arg_end(); arg++) {
         newZ3Var(arg, CD, c);
     }
     for (BasicBlock &BB : F) {
+        PathBuckets forked;
         MNode *mnode = CD.getMNode(&F, &BB);
         if (mnode == nullptr) {
-            extendPaths(&F, &BB, std::set<EdgeType>(), nullptr, CD, c);
+            extendPaths(&F, &BB, std::set<EdgeType>(), nullptr, CD, c, live, forked);
         } else {
-            extendPaths(&F, &BB, mnode->edges, mnode, CD, c);
+            extendPaths(&F, &BB, mnode->edges, mnode, CD, c, live, forked);
+        }
+        // only forked paths got new constraints, and only the buckets they join (or the executed one) can hold new duplicates
+        auto executed = live.find(&BB);
+        if (executed != live.end()) {
+            mergePaths(executed->second);
+        }
+        for (auto &it : forked) {
+            cleanPaths(it.second);
+            std::list<Path> &bucket = live[it.first];
+            bucket.splice(bucket.end(), it.second);
+            mergePaths(bucket);
+        }
+    }
+
+    std::vector<Path> &paths = funcPaths[&F];
+    paths.clear();
+    for (BasicBlock &BB : F) {
+        auto bucket = live.find(&BB);
+        if (bucket != live.end()) {
+            paths.insert(paths.end(), bucket->second.begin(), bucket->second.end());
         }
-        cleanPaths(&F, c);
-        mergePaths(&F);
     }
 
     unsigned int path_cnt = 0;
@@ -207,6 +240,8 @@ bool TrafficRuleInfo::runOnFunction(Function &F, ControlDependency &CD, z3::cont
     errs() << "Eval path: " << path_cnt << "\n";
 
     finalizePaths(&F, CD, c);
+    feasibility->pop();
+    analyzing.erase(&F);
 
 #ifdef DEBUG
     errs() << "Print paths of Function " << demangle(F.getName().str().c_str()) << "\n";
@@ -215,12 +250,56 @@ bool TrafficRuleInfo::runOnFunction(Function &F, ControlDependency &CD, z3::cont
     return false;
 }
 
+const CalleeSummary *TrafficRuleInfo::getCalleeSummary(Function *F, ControlDependency &CD, z3::context &c) {
+    auto cached = summaries.find(F);
+    if (cached != summaries.end()) {
+        return &cached->second;
+    }
+    if (analyzing.find(F) != analyzing.end()) {
+        return nullptr;
+    }
+    // formals are left unbound, so the summary holds for every call site
+    runOnFunction(*F, CD, c);
+
+    CalleeSummary &summary = summaries[F];
+    for (Argument *arg = F->arg_begin(); arg != F->arg_end(); arg++) {
+        auto var = globalVars.find(arg);
+        summary.formals.push_back(var == globalVars.end() ? nullptr : var->second);
+    }
+    if (returnExprs.find(F) != returnExprs.end()) {
+        summary.ret = returnExprs[F];
+    }
+    for (Path &P : funcPaths[F]) {
+        summary.pathCount += P.weight;
+    }
+    return &summary;
+}
+
+z3::expr *TrafficRuleInfo::instantiate(Function *F, z3::expr *e, const std::vector<z3::expr *> &actuals, z3::context &c) {
+    auto summary = summaries.find(F);
+    if (e == nullptr || summary == summaries.end()) {
+        return e;
+    }
+    z3::expr_vector from(c), to(c);
+    const std::vector<z3::expr *> &formals = summary->second.formals;
+    for (unsigned i = 0; i < formals.size() && i < actuals.size(); i++) {
+        if (formals[i] == nullptr || actuals[i] == nullptr || !z3::eq(formals[i]->get_sort(), actuals[i]->get_sort())) continue;
+        from.push_back(*formals[i]);
+        to.push_back(*actuals[i]);
+    }
+    if (from.size() == 0) {
+        return e;
+    }
+    z3::expr instance = *e;
+    return newExpr(instance.substitute(from, to));
+}
+
 bool TrafficRuleInfo::runOnModule(Module &M) {
     z3::context c;
     ControlDependency &CD = getAnalysis<ControlDependency>();
     initRetExprs(CD, c);
-    getHardcodeMap(M, CD, c);
-    getApiFuncName();
+    initHardcode(M, CD, c);
+    feasibility.reset(new FeasibilityChecker(c));
 
     std::set<Function *> interSet;
     for (auto source : CD.TargetSourcePtrs) {
@@ -235,9 +314,27 @@ bool TrafficRuleInfo::runOnModule(Module &M) {
     res.erase(std::remove(res.begin(), res.end(), '|'), res.end());
     errs() << res << "\n";
 
+    // the expressions have to go before the context
+    releaseExprs();
     return false;
 }
 
+void TrafficRuleInfo::releaseExprs() {
+    funcPaths.clear();
+    returnExprs.clear();
+    funcConstraints.clear();
+    globalVars.clear();
+    result = nullptr;
+    globalConstraints.clear();
+    hardcode.clear();
+    summaries.clear();
+    callBindings.clear();
+    analyzing.clear();
+    simplifiedExprs.clear();
+    feasibility.reset();
+    exprs.reset();
+}
+
 bool TrafficRuleInfo::doInitialization(Module &M) {
     return false;
 }
@@ -257,50 +354,164 @@ void TrafficRuleInfo::initRetExprs(ControlDependency &CD, z3::context &c) {
     }
 }
 
-void TrafficRuleInfo::extractConstraint(ControlDependency &CD, z3::context &c) {
-    result = new z3::expr(c.bool_val(false));
-    for (auto chain : CD.CallChains) {
-        z3::expr *tmpConstraint = new z3::expr(c.bool_val(true));
-        Function *prev = nullptr;
-        for (Function *F : chain) {
-            // errs() << "FUNC " << beautyFuncName(F) << "\n";
-            if (prev != nullptr) {
-                if (funcConstraints[prev][F] != nullptr) {
-                    // errs() << "CONSTRAINT " << funcConstraints[prev][F]->to_string() << "\n";
-                    if (funcConstraints[prev][F]->is_arith()) {
-                        funcConstraints[prev][F] = new z3::expr(*funcConstraints[prev][F] > 0);
-                    }
-                    if (funcConstraints[prev][F]->is_bool()) {
-                        tmpConstraint = new z3::expr((*tmpConstraint && *(funcConstraints[prev][F])).simplify());
-                    }
-                } else {
-                    tmpConstraint = new z3::expr(*tmpConstraint && c.bool_val(false));
+z3::expr *TrafficRuleInfo::newHardcodeExpr(const HardcodeRule &rule, z3::context &c) {
+    if (rule.type == "bool") {
+        return newExpr(c.bool_val(rule.value == "true"));
+    } else if (rule.type == "int") {
+        return newExpr(c.int_val(rule.value.c_str()));
+    } else {
+        return newExpr(c.real_val(rule.value.c_str()));
+    }
+}
+
+void TrafficRuleInfo::initHardcode(Module &M, ControlDependency &CD, z3::context &c) {
+    CalleeRegistry &registry = getCalleeRegistry();
+    for (const HardcodeRule &rule : registry.getGlobalHardcodes()) {
+        GlobalVariable *gvar = M.getGlobalVariable(rule.callee, true);
+        if (gvar != nullptr) {
+            hardcode[gvar] = newHardcodeExpr(rule, c);
+        }
+    }
+    for (Function *F : CD.TargetFuncPtrs) {
+        for (BasicBlock &BB : *F) {
+            for (Instruction &I : BB) {
+                if (!isa<CallBase>(&I)) continue;
+                const HardcodeRule *rule = registry.getHardcode(F, getCalledFunction(dyn_cast<CallBase>(&I)));
+                if (rule != nullptr) {
+                    hardcode[&I] = newHardcodeExpr(*rule, c);
                 }
             }
-            prev = F;
         }
-        // errs() << "CHAIN " << tmpConstraint->to_string() << "\n";
-        result = new z3::expr(*result || *tmpConstraint);
+    }
+}
+
+void TrafficRuleInfo::extractConstraint(ControlDependency &CD, z3::context &c) {
+    // result = OR over source -> sink call chains of AND over the chain's call constraints,
+    // computed per function over the call DAG so chains sharing a suffix share its constraint
+    result = newExpr(c.bool_val(false));
+    std::map<Function *, z3::expr *> chainConstraints;
+    std::set<Function *> visiting;
+    std::set<Function *> cyclic;
+    findCyclicFunctions(CD, cyclic);
+    for (Function *source : CD.TargetSourcePtrs) {
+        z3::expr *sourceConstraint = getChainConstraint(source, CD, c, chainConstraints, visiting, cyclic);
+        if (sourceConstraint != nullptr) {
+            // errs() << "CHAIN " << sourceConstraint->to_string() << "\n";
+            result = newExpr(*result || *sourceConstraint);
+        }
     }
     for (auto c : globalConstraints) {
-        result = new z3::expr(*result && *c);
+        result = newExpr(*result && *c);
+    }
+    result = newExpr(result->simplify());
+}
+
+// Tarjan's SCCs of the call DAG: cyclic gets the functions of the SCCs with a cycle (more than one function, or a
+// function calling itself)
+void TrafficRuleInfo::findCyclicFunctions(ControlDependency &CD, std::set<Function *> &cyclic) {
+    std::map<Function *, unsigned> index, lowlink;
+    std::vector<Function *> stack;
+    std::set<Function *> onStack;
+    std::function<void(Function *)> visit = [&](Function *F) {
+        unsigned id = index.size();
+        index[F] = lowlink[F] = id;
+        stack.push_back(F);
+        onStack.insert(F);
+        auto callees = CD.CallDAG.find(F);
+        if (callees != CD.CallDAG.end()) {
+            for (Function *callee : callees->second) {
+                if (index.find(callee) == index.end()) {
+                    visit(callee);
+                    lowlink[F] = std::min(lowlink[F], lowlink[callee]);
+                } else if (onStack.find(callee) != onStack.end()) {
+                    lowlink[F] = std::min(lowlink[F], index[callee]);
+                }
+            }
+        }
+        if (lowlink[F] != index[F]) {
+            return;
+        }
+        Function *member = nullptr;
+        bool isCycle = stack.back() != F || (callees != CD.CallDAG.end() && callees->second.count(F) > 0);
+        do {
+            member = stack.back();
+            stack.pop_back();
+            onStack.erase(member);
+            if (isCycle) {
+                cyclic.insert(member);
+            }
+        } while (member != F);
+    };
+    for (auto &it : CD.CallDAG) {
+        if (index.find(it.first) == index.end()) {
+            visit(it.first);
+        }
     }
-    result = new z3::expr(result->simplify());
 }
 
-void TrafficRuleInfo::extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType> edges, MNode *N, ControlDependency &CD, z3::context &c) {
+// Constraint under which F reaches a sink along some acyclic call chain, or nullptr if no chain leads from F to a sink.
+// Chains do not go back through the functions being visited, so the result of a function on a cycle depends on how
+// the walk reached it and is not cached; outside cycles nothing F reaches can be on the walk, and its result is.
+z3::expr *TrafficRuleInfo::getChainConstraint(Function *F, ControlDependency &CD, z3::context &c, std::map<Function *, z3::expr *> &chainConstraints, std::set<Function *> &visiting, const std::set<Function *> &cyclic) {
+    auto cached = chainConstraints.find(F);
+    if (cached != chainConstraints.end()) {
+        return cached->second;
+    }
+    if (CD.TargetSinkPtrs.find(F) != CD.TargetSinkPtrs.end()) {
+        return chainConstraints[F] = newExpr(c.bool_val(true));
+    }
+    auto callees = CD.CallDAG.find(F);
+    if (callees == CD.CallDAG.end()) {
+        return chainConstraints[F] = nullptr;
+    }
+
+    visiting.insert(F);
+    z3::expr *constraint = nullptr;
+    for (Function *callee : callees->second) {
+        // calls back into the walk close a cycle
+        if (visiting.find(callee) != visiting.end()) continue;
+        z3::expr *calleeConstraint = getChainConstraint(callee, CD, c, chainConstraints, visiting, cyclic);
+        if (calleeConstraint == nullptr) continue;
+        // the callee's constraint is over its formals: bind them to the arguments it gets from F
+        auto binding = callBindings[callee].find(F);
+        if (binding != callBindings[callee].end()) {
+            calleeConstraint = instantiate(callee, calleeConstraint, binding->second, c);
+        }
+        // errs() << "FUNC " << beautyFuncName(callee) << " <- " << beautyFuncName(F) << "\n";
+        z3::expr *callConstraint = funcConstraints[callee][F];
+        z3::expr edgeConstraint = c.bool_val(false);
+        if (callConstraint != nullptr) {
+            if (callConstraint->is_arith()) {
+                callConstraint = funcConstraints[callee][F] = newExpr(*callConstraint > 0);
+            }
+            if (callConstraint->is_bool()) {
+                edgeConstraint = (*calleeConstraint && *callConstraint).simplify();
+            } else {
+                edgeConstraint = *calleeConstraint;
+            }
+        }
+        constraint = constraint == nullptr ? newExpr(edgeConstraint) : newExpr((*constraint || edgeConstraint).simplify());
+    }
+    visiting.erase(F);
+    if (cyclic.find(F) != cyclic.end()) {
+        return constraint;
+    }
+    return chainConstraints[F] = constraint;
+}
+
+void TrafficRuleInfo::extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType> edges, MNode *N, ControlDependency &CD, z3::context &c, PathBuckets &live, PathBuckets &forked) {
 #ifdef DEBUG
     errs() << "BB " << BB->getName() << " processing\n";
 #endif
-    std::vector<Path> newPaths;
+    auto waiting = live.find(BB);
+    if (waiting == live.end()) {
+        extendedBlocks.insert(BB);
+        return;
+    }
+    std::list<Path> &paths = waiting->second;
     std::map<BasicBlock *, std::set<BasicBlock *>> finalNextCache;
-    auto pit = funcPaths[F].begin();
-    while (pit != funcPaths[F].end()) {
-        if (pit->next != BB) {
-            pit++;
-            continue;
-        }
-
+    auto pit = paths.begin();
+    while (pit != paths.end()) {
         if (N != nullptr) {
             executeBlock(&*pit, N, CD, c);
         }
@@ -393,11 +604,13 @@ void TrafficRuleInfo::extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType
             if (N) {
                 executeBranch(&newPath, N, next, CD, c);
             }
-            newPaths.push_back(newPath);
+            // remove impossible paths
+            if (simplified(*(newPath.constraint))->is_false()) continue;
+            forked[next].push_back(newPath);
         }
 
-        if (newPaths.size() > 0) {
-            pit = funcPaths[F].erase(pit);
+        if (finalNexts.size() > 0) {
+            pit = paths.erase(pit);
         } else {
             pit++;
         }
@@ -407,33 +620,53 @@ void TrafficRuleInfo::extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType
         }
     }
 
-    for (Path P : newPaths) {
-        funcPaths[F].push_back(P);
-    }
+    extendedBlocks.insert(BB);
+}
 
-    // remove impossible paths
-    pit = funcPaths[F].begin();
-    while (pit != funcPaths[F].end()) {
-        if (pit->constraint->simplify().to_string() == "false") {
-            pit = funcPaths[F].erase(pit);
-        } else {
-            pit++;
-        }
+bool FeasibilityChecker::feasible(const z3::expr &constraint) {
+    if (constraint.is_true()) {
+        return true;
     }
+    if (constraint.is_false()) {
+        return false;
+    }
+    unsigned id = Z3_get_ast_id(c, constraint);
+    auto cached = verdicts.find(id);
+    if (cached != verdicts.end()) {
+        return cached->second;
+    }
+    z3::expr guard(c, Z3_mk_fresh_const(c, "path", c.bool_sort()));
+    solver.add(z3::implies(guard, constraint));
+    z3::expr_vector assumptions(c);
+    assumptions.push_back(guard);
+    bool sat = solver.check(assumptions) == z3::sat;
+    if (!sat) {
+        // never assumed again: let the solver drop the clauses behind it
+        solver.add(!guard);
+    }
+    return verdicts[id] = sat;
+}
 
-    extendedBlocks.insert(BB);
-    // errs() << "num of paths: " << funcPaths[F].size() << "\n";
+z3::expr *TrafficRuleInfo::simplified(const z3::expr &e) {
+    unsigned id = Z3_get_ast_id(e.ctx(), e);
+    auto cached = simplifiedExprs.find(id);
+    if (cached != simplifiedExprs.end()) {
+        return cached->second;
+    }
+    // keep the key alive in the arena, so its id is not recycled for another expression
+    newExpr(e);
+    z3::expr *result = newExpr(e.simplify());
+    simplifiedExprs[Z3_get_ast_id(e.ctx(), *result)] = result;
+    return simplifiedExprs[id] = result;
 }
 
-void TrafficRuleInfo::cleanPaths(Function *F, z3::context &c) {
-    auto pit = funcPaths[F].begin();
-    while (pit != funcPaths[F].end()) {
-        z3::solver s(c);
-        s.add(*(pit->constraint));
-        if (s.check() == z3::sat) {
+void TrafficRuleInfo::cleanPaths(std::list<Path> &paths) {
+    auto pit = paths.begin();
+    while (pit != paths.end()) {
+        if (feasibility->feasible(*(pit->constraint))) {
             pit++;
         } else {
-            funcPaths[F].erase(pit);
+            pit = paths.erase(pit);
         }
     }
 }
@@ -460,29 +693,36 @@ void TrafficRuleInfo::finalizePaths(Function *F, ControlDependency &CD, z3::cont
         if (!snode) continue;
         Function *callee = snode->to;
         if (tmpConstraints.find(callee) == tmpConstraints.end()) {
-            tmpConstraints[callee] = new z3::expr(*(path.constraint));
+            tmpConstraints[callee] = newExpr(*(path.constraint));
         } else {
-            tmpConstraints[callee] = new z3::expr((*(tmpConstraints[callee]) || *(path.constraint)).simplify());
+            tmpConstraints[callee] = simplified(*(tmpConstraints[callee]) || *(path.constraint));
         }
     }
     for (auto it = tmpConstraints.begin(); it != tmpConstraints.end(); it++) {
-        funcConstraints[it->first][F] = new z3::expr(it->second->simplify());
+        funcConstraints[it->first][F] = simplified(*(it->second));
     }
 }
 
-void TrafficRuleInfo::mergePaths(Function *F) {
-    auto a = funcPaths[F].begin();
-    while (a != funcPaths[F].end()) {
-        auto b = a + 1;
-        while (b != funcPaths[F].end()) {
+void TrafficRuleInfo::mergePaths(std::list<Path> &paths) {
+    // equal paths have equal hashes: only compare the paths of one hash bucket
+    std::unordered_map<size_t, std::vector<std::list<Path>::iterator>> buckets;
+    auto b = paths.begin();
+    while (b != paths.end()) {
+        std::vector<std::list<Path>::iterator> &same = buckets[b->hash()];
+        bool merged = false;
+        for (auto a : same) {
             if (*a == *b) {
-                a->constraint = new z3::expr((*(a->constraint) || *(b->constraint)).simplify());
-                funcPaths[F].erase(b);
-            } else {
-                b++;
+                a->constraint = simplified(*(a->constraint) || *(b->constraint));
+                merged = true;
+                break;
             }
         }
-        a++;
+        if (merged) {
+            b = paths.erase(b);
+        } else {
+            same.push_back(b);
+            b++;
+        }
     }
 }
 
@@ -498,11 +738,9 @@ void TrafficRuleInfo::printPaths(Function *F) {
 
 void TrafficRuleInfo::executeBlock(Path *P, MNode *N, ControlDependency &CD, z3::context &c) {
     P->nodes.push_back(N);
-    // execute path slides
-    for (Instruction &I : *(N->BB)) {
-        if (N->instrs.find(&I) != N->instrs.end()) {
-            executeInstruction(P, N, &I, CD, c);
-        }
+    // execute path slides (instrs are kept in block order)
+    for (Instruction *I : N->instrs) {
+        executeInstruction(P, N, I, CD, c);
     }
 }
 
@@ -519,7 +757,7 @@ void TrafficRuleInfo::executeBranch(Path *P, MNode *N, BasicBlock *next, Control
                 Instruction *def = getUniqueDefinition(P, N, I, cond);
                 condE = getZ3Expr(P, def);
             } else {
-                condE = new z3::expr(c.bool_val(true));
+                condE = newExpr(c.bool_val(true));
             }
             // sanity check
             if (condE == nullptr) {
@@ -527,7 +765,7 @@ void TrafficRuleInfo::executeBranch(Path *P, MNode *N, BasicBlock *next, Control
                 return;
             }
             if (condE->is_arith()) {
-                condE = new z3::expr(*condE > 0);
+                condE = newExpr(*condE > 0);
             }
 #ifdef DEBUG
             errs() << "  BRANCH " << *I << " " << condE->to_string() << "\n";
@@ -536,10 +774,10 @@ void TrafficRuleInfo::executeBranch(Path *P, MNode *N, BasicBlock *next, Control
             if (succNum == 2) {
                 if (next == I->getSuccessor(0)) {
                     // errs() << "cond " << next->getName() << " " << condE->to_string() << "\n";
-                    P->constraint = new z3::expr((*latest && *condE).simplify());
+                    P->constraint = simplified(*latest && *condE);
                 } else if (next == I->getSuccessor(1)) {
                     // errs() << "cond " << next->getName() << " not" << condE->to_string() << "\n";
-                    P->constraint = new z3::expr((*latest && !(*condE)).simplify());
+                    P->constraint = simplified(*latest && !(*condE));
                 }
             }
             break;
@@ -603,7 +841,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
     }
 
     if (hardcode.find(I) != hardcode.end()) {
-        P->vars[I] = hardcode[I];
+        P->setVar(I, hardcode[I]);
 #ifdef DEBUG
         errs() << "Hardcode " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -621,7 +859,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                         errs() << "error PHI " << *I << "\n";
                         return;
                     }
-                    P->vars[I] = ops[i];
+                    P->setVar(I, ops[i]);
                     break;
                 }
             }
@@ -643,7 +881,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error ALLOCA " << *I << "\n";
                 return;
             };
-            P->vars[I] = e;
+            P->setVar(I, e);
 
 #ifdef DEBUG
             errs() << "  ALLOCA " << *I << " " << P->vars[I]->to_string() << "\n";
@@ -656,7 +894,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error GETELEMENTPTR " << *I << "\n";
                 return;
             };
-            P->vars[I] = e;
+            P->setVar(I, e);
 #ifdef DEBUG
             errs() << "  GETELEMENTPTR " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -673,61 +911,54 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
 
             auto vec = P->vectorStatus.tainted(I);
 
-            std::string calledFuncName = demangle(calledFunc->getName().str().c_str());
+            unsigned calleeClass = getCalleeRegistry().getClass(calledFunc);
             if (vec != nullptr) {
-                if (calledFuncName.find("empty") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.bool_val(!P->vectorStatus.getStatus(vec)));
-                } else if (calledFuncName.find("size") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.int_val(P->vectorStatus.getStatus(vec) ? 1:0));
-                } else if (calledFuncName.find("operator!=") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.bool_val(P->vectorStatus.getStatus(vec)));
-                } else if (calledFuncName.find("push_back") != std::string::npos) {
-                    P->vectorStatus.setStatus(vec, true);
-                } else if (calledFuncName.find("emplace_back") != std::string::npos) {
+                if (calleeClass & CALLEE_VECTOR_EMPTY) {
+                    P->setVar(I, newExpr(c.bool_val(!P->vectorStatus.getStatus(vec))));
+                } else if (calleeClass & CALLEE_VECTOR_SIZE) {
+                    P->setVar(I, newExpr(c.int_val(P->vectorStatus.getStatus(vec) ? 1:0)));
+                } else if (calleeClass & CALLEE_VECTOR_NOT_EQUAL) {
+                    P->setVar(I, newExpr(c.bool_val(P->vectorStatus.getStatus(vec))));
+                } else if (calleeClass & CALLEE_VECTOR_PUSH) {
                     P->vectorStatus.setStatus(vec, true);
                 }
             } else {
-                if (calledFuncName.find("empty") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.bool_val(false));
-                } else if (calledFuncName.find("size") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.int_val(1));
-                } else if (calledFuncName.find("operator!=") != std::string::npos) {
-                    P->vars[I] = new z3::expr(c.bool_val(true));
+                if (calleeClass & CALLEE_VECTOR_EMPTY) {
+                    P->setVar(I, newExpr(c.bool_val(false)));
+                } else if (calleeClass & CALLEE_VECTOR_SIZE) {
+                    P->setVar(I, newExpr(c.int_val(1)));
+                } else if (calleeClass & CALLEE_VECTOR_NOT_EQUAL) {
+                    P->setVar(I, newExpr(c.bool_val(true)));
                 }
             }
 
             if (P->vars.find(I) == P->vars.end()) {
-                if (calledFuncName.find("dynamic_cast") != std::string::npos) {
+                if (calleeClass & CALLEE_DYNAMIC_CAST) {
                     if (isa<Instruction>(II->getArgOperand(0))) {
                         Instruction *def = dyn_cast<Instruction>(II->getArgOperand(1));
                         if (P->vars.find(def) != P->vars.end()) {
-                            P->vars[I] = P->vars[def];
+                            P->setVar(I, P->vars[def]);
                         }
                     }
                 }
             }
 
             if (P->vars.find(I) == P->vars.end()) {
-                if (std_function(calledFunc->getName().str().c_str())) {
-                    P->vars[I] = newZ3DefaultConst(I->getType(), c);
+                if (calleeClass & CALLEE_STD_HELPER) {
+                    P->setVar(I, newZ3DefaultConst(I->getType(), c));
                 } else if (CD.TargetFuncPtrs.find(calledFunc) != CD.TargetFuncPtrs.end()) {
-                    unsigned cnt = 0;
-                    for (Argument *arg = calledFunc->arg_begin(); arg != calledFunc->arg_end(); arg++) {
-                        if (globalVars.find(arg) == globalVars.end() && ops.size() > cnt && ops[cnt] != nullptr) {
-                            globalVars[arg] = ops[cnt];
+                    const CalleeSummary *summary = getCalleeSummary(calledFunc, CD, c);
+                    if (summary != nullptr) {
+                        std::vector<z3::expr *> actuals(ops.begin(), ops.begin() + std::min<size_t>(ops.size(), II->arg_size()));
+                        std::map<Function *, std::vector<z3::expr *>> &bindings = callBindings[calledFunc];
+                        if (bindings.find(P->F) == bindings.end()) {
+                            bindings[P->F] = actuals;
+                        }
+                        // for evaluation
+                        P->weight *= summary->pathCount;
+                        if (summary->ret != nullptr) {
+                            P->setVar(I, instantiate(calledFunc, summary->ret, actuals, c));
                         }
-                        cnt++;
-                    }
-                    runOnFunction(*calledFunc, CD, c);
-                    // for evaluation
-                    unsigned int path_cnt = 0;
-                    for (Path PP : funcPaths[calledFunc]) {
-                        path_cnt += PP.weight;
-                    }
-                    
-                    P->weight *= path_cnt;
-                    if (returnExprs.find(calledFunc) != returnExprs.end()) {
-                        P->vars[I] = returnExprs[calledFunc];
                     }
                 }
             }
@@ -738,7 +969,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                     errs() << "error INVOKE/CALL " << *I << "\n";
                     return;
                 }
-                P->vars[I] = e;
+                P->setVar(I, e);
             }
 #ifdef DEBUG
             errs() << "  INVOKE/CALL " << *I << " " << P->vars[I]->to_string() << "\n";
@@ -752,7 +983,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error LOAD " << *I << "\n";
                 return;
             }
-            P->vars[I] = e;
+            P->setVar(I, e);
 #ifdef DEBUG
             errs() << "  LOAD " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -766,9 +997,9 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 return;
             }
             if (isa<Instruction>(to)) {
-                P->vars[dyn_cast<Instruction>(to)] = e;
+                P->setVar(dyn_cast<Instruction>(to), e);
             }
-            P->vars[I] = e;
+            P->setVar(I, e);
 #ifdef DEBUG
             errs() << "  STORE " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -780,10 +1011,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             z3::expr *rightE = ops[1];
 
             if (leftE->is_bool()) {
-                leftE = new z3::expr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
+                leftE = newExpr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
             }
             if (rightE->is_bool()) {
-                rightE = new z3::expr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
+                rightE = newExpr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
             }
 
             // sanity checks
@@ -792,7 +1023,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 return;
             }
 
-            P->vars[I] = new z3::expr(*leftE + *rightE);
+            P->setVar(I, newExpr(*leftE + *rightE));
 #ifdef DEBUG
             errs() << "  ADD " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -804,10 +1035,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             z3::expr *rightE = ops[1];
 
             if (leftE->is_bool()) {
-                leftE = new z3::expr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
+                leftE = newExpr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
             }
             if (rightE->is_bool()) {
-                rightE = new z3::expr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
+                rightE = newExpr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
             }
 
             // sanity checks
@@ -816,7 +1047,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 return;
             }
 
-            P->vars[I] = new z3::expr(*leftE - *rightE);
+            P->setVar(I, newExpr(*leftE - *rightE));
 #ifdef DEBUG
             errs() << "  SUB " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -828,10 +1059,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             z3::expr *rightE = ops[1];
 
             if (leftE->is_bool()) {
-                leftE = new z3::expr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
+                leftE = newExpr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
             }
             if (rightE->is_bool()) {
-                rightE = new z3::expr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
+                rightE = newExpr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
             }
 
             // sanity checks
@@ -840,7 +1071,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 return;
             }
 
-            P->vars[I] = new z3::expr(*leftE * *rightE);
+            P->setVar(I, newExpr(*leftE * *rightE));
 #ifdef DEBUG
             errs() << "  MUL " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -853,10 +1084,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             z3::expr *rightE = ops[1];
 
             if (leftE->is_bool()) {
-                leftE = new z3::expr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
+                leftE = newExpr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
             }
             if (rightE->is_bool()) {
-                rightE = new z3::expr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
+                rightE = newExpr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
             }
 
             // sanity checks
@@ -865,7 +1096,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 return;
             }
 
-            P->vars[I] = new z3::expr(*leftE / *rightE);
+            P->setVar(I, newExpr(*leftE / *rightE));
 #ifdef DEBUG
             errs() << "  DIV " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -882,10 +1113,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 // pass
             } else {
                 if (leftE->is_bool()) {
-                    leftE = new z3::expr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
+                    leftE = newExpr(z3::ite(*leftE, c.int_val(1), c.int_val(0)));
                 }
                 if (rightE->is_bool()) {
-                    rightE = new z3::expr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
+                    rightE = newExpr(z3::ite(*rightE, c.int_val(1), c.int_val(0)));
                 }
             }
 
@@ -898,51 +1129,51 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             // switch predicates
             switch (II->getPredicate()) {
                 case FCmpInst::FCMP_FALSE: {
-                    P->vars[I] = new z3::expr(c.bool_val(false));
+                    P->setVar(I, newExpr(c.bool_val(false)));
                     break;
                 }
                 case FCmpInst::FCMP_TRUE: {
-                    P->vars[I] = new z3::expr(c.bool_val(true));
+                    P->setVar(I, newExpr(c.bool_val(true)));
                     break;
                 }
                 case FCmpInst::FCMP_OEQ:
                 case ICmpInst::ICMP_EQ:
                 case FCmpInst::FCMP_UEQ: {
-                    P->vars[I] = new z3::expr(*leftE == *rightE);
+                    P->setVar(I, newExpr(*leftE == *rightE));
                     break;
                 }
                 case FCmpInst::FCMP_OGT:
                 case ICmpInst::ICMP_SGT:
                 case FCmpInst::FCMP_UGT:
                 case ICmpInst::ICMP_UGT: {
-                    P->vars[I] = new z3::expr(*leftE > *rightE);
+                    P->setVar(I, newExpr(*leftE > *rightE));
                     break;
                 }
                 case FCmpInst::FCMP_OGE:
                 case ICmpInst::ICMP_SGE:
                 case FCmpInst::FCMP_UGE:
                 case ICmpInst::ICMP_UGE: {
-                    P->vars[I] = new z3::expr(*leftE >= *rightE);
+                    P->setVar(I, newExpr(*leftE >= *rightE));
                     break;
                 }
                 case FCmpInst::FCMP_OLT:
                 case ICmpInst::ICMP_SLT:
                 case FCmpInst::FCMP_ULT:
                 case ICmpInst::ICMP_ULT: {
-                    P->vars[I] = new z3::expr(*leftE < *rightE);
+                    P->setVar(I, newExpr(*leftE < *rightE));
                     break;
                 }
                 case FCmpInst::FCMP_OLE:
                 case ICmpInst::ICMP_SLE:
                 case FCmpInst::FCMP_ULE:
                 case ICmpInst::ICMP_ULE: {
-                    P->vars[I] = new z3::expr(*leftE <= *rightE);
+                    P->setVar(I, newExpr(*leftE <= *rightE));
                     break;
                 }
                 case FCmpInst::FCMP_ONE:
                 case FCmpInst::FCMP_UNE:
                 case ICmpInst::ICMP_NE: {
-                    P->vars[I] = new z3::expr(!(*leftE == *rightE));
+                    P->setVar(I, newExpr(!(*leftE == *rightE)));
                     break;
                 }
                 // case FCmpInst::FCMP_ORD:
@@ -966,18 +1197,18 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error RET " << *I << "\n";
                 return;
             }
-            P->vars[I] = new z3::expr(*e);
+            P->setVar(I, newExpr(*e));
 #ifdef DEBUG
             errs() << "  RET " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
             if (returnExprs.find(P->F) != returnExprs.end()) {
                 // TODO: type match
                 if (returnExprs[P->F]->is_bool() && P->vars[I]->is_arith()) {
-                    P->vars[I] = new z3::expr(*(P->vars[I]) > 0);
+                    P->setVar(I, newExpr(*(P->vars[I]) > 0));
                 } else if (returnExprs[P->F]->is_arith() && P->vars[I]->is_bool()) {
-                    P->vars[I] = new z3::expr(z3::ite(*P->vars[I], c.real_val(1), c.real_val(0)));
+                    P->setVar(I, newExpr(z3::ite(*P->vars[I], c.real_val(1), c.real_val(0))));
                 }
-                returnExprs[P->F] = new z3::expr(z3::ite(*(P->constraint), *(P->vars[I]), *(returnExprs[P->F])));
+                returnExprs[P->F] = newExpr(z3::ite(*(P->constraint), *(P->vars[I]), *(returnExprs[P->F])));
             }
             break;
         }
@@ -987,10 +1218,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error TRUNC " << *I << "\n";
                 return;
             }
-            P->vars[I] = e;
+            P->setVar(I, e);
             // Type *T = I->getType();
             // if (e->is_arith() && T->isIntegerTy(1)) {
-            //     P->vars[I] = new z3::expr(*e > 0);
+            //     P->vars[I] = newExpr(*e > 0);
             // } else {
             //     P->vars[I] = e;
             // }
@@ -1006,10 +1237,10 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error ZEXT " << *I << "\n";
                 return;
             }
-            P->vars[I] = e;
+            P->setVar(I, e);
             // Type *T = I->getType();
             // if (e->is_bool() && T->isIntegerTy() && T->getIntegerBitWidth() > 1) {
-            //     P->vars[I] = new z3::expr(z3::ite(*e, c.int_val(1), c.int_val(0)));
+            //     P->vars[I] = newExpr(z3::ite(*e, c.int_val(1), c.int_val(0)));
             // } else {
             //     P->vars[I] = e;
             // }
@@ -1024,7 +1255,7 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
                 errs() << "error BITCAST " << *I << "\n";
                 return;
             }
-            P->vars[I] = e;
+            P->setVar(I, e);
 #ifdef DEBUG
             errs() << "  BITCAST " << *I << " " << P->vars[I]->to_string() << "\n";
 #endif
@@ -1035,12 +1266,12 @@ void TrafficRuleInfo::executeInstruction(Path *P, MNode *N, Instruction *I, Cont
             z3::expr *rightE = ops[1];
 
             if (leftE->is_arith()) {
-                leftE = new z3::expr(*leftE > 0);
+                leftE = newExpr(*leftE > 0);
             }
             if (rightE->is_arith()) {
-                rightE = new z3::expr(*rightE > 0);
+                rightE = newExpr(*rightE > 0);
             }
-            P->vars[I] = new z3::expr(*leftE != *rightE);
+            P->setVar(I, newExpr(*leftE != *rightE));
             break;
         }
         default:
@@ -1063,15 +1294,15 @@ z3::expr *TrafficRuleInfo::newZ3Const(Constant *C, z3::context &c) {
             ConstantInt *val = dyn_cast<ConstantInt>(C);
             if (T->isIntegerTy(1)) {
                 if (C->isNullValue()) {
-                    e = new z3::expr(c.bool_val(false));
+                    e = newExpr(c.bool_val(false));
                 } else {
-                    e = new z3::expr(c.bool_val(val->getSExtValue() != 0 ? true : false));
+                    e = newExpr(c.bool_val(val->getSExtValue() != 0 ? true : false));
                 }
             } else {
                 if (C->isNullValue()) {
-                    e = new z3::expr(c.int_val(0));
+                    e = newExpr(c.int_val(0));
                 } else {
-                    e = new z3::expr(c.int_val(val->getSExtValue()));
+                    e = newExpr(c.int_val(val->getSExtValue()));
                 }
             }
             break;
@@ -1081,14 +1312,14 @@ z3::expr *TrafficRuleInfo::newZ3Const(Constant *C, z3::context &c) {
         case Type::HalfTyID: {
             ConstantFP *val = dyn_cast<ConstantFP>(C);
             if (C->isNullValue()) {
-                e = new z3::expr(c.real_val(0));
+                e = newExpr(c.real_val(0));
             } else {
-                e = new z3::expr(c.real_val(int(val->getValueAPF().convertToDouble())));
+                e = newExpr(c.real_val(int(val->getValueAPF().convertToDouble())));
             }
             break;
         }
         default: {
-            e = new z3::expr(c.bool_val(false));
+            e = newExpr(c.bool_val(false));
             break;
         }
     }
@@ -1107,9 +1338,9 @@ z3::expr *TrafficRuleInfo::newZ3DefaultConst(Type *T, z3::context &c) {
     switch (T->getTypeID()) {
         case Type::IntegerTyID: {
             if (T->isIntegerTy(1)) {
-                e = new z3::expr(c.bool_val(false));
+                e = newExpr(c.bool_val(false));
             } else {
-                e = new z3::expr(c.int_val(0));
+                e = newExpr(c.int_val(0));
             }
             break;
         }
@@ -1117,7 +1348,7 @@ z3::expr *TrafficRuleInfo::newZ3DefaultConst(Type *T, z3::context &c) {
         case Type::FloatTyID:
         case Type::HalfTyID:
         default: {
-            e = new z3::expr(c.bool_val(false));
+            e = newExpr(c.bool_val(false));
             break;
         }
     }
@@ -1139,9 +1370,7 @@ z3::expr *TrafficRuleInfo::newZ3Var(Value *I, ControlDependency &CD, z3::context
     std::string name = getVarName(I, CD);
     if (isa<CallBase>(I)) {
         CallBase *II = dyn_cast<CallBase>(I);
-        Function *func = getCalledFunction(II);
-        std::string funcName = demangle(func->getName().str().c_str());
-        if (apiFuncName.find(funcName) != apiFuncName.end()) {
+        if (getCalleeRegistry().is(getCalledFunction(II), CALLEE_API)) {
             name += "{";
             for (unsigned i = 0; i < II->arg_size(); i++) {
                 Value *arg = II->getArgOperand(i);
@@ -1164,20 +1393,20 @@ z3::expr *TrafficRuleInfo::newZ3Var(Value *I, ControlDependency &CD, z3::context
     switch (T->getTypeID()) {
         case Type::IntegerTyID: {
             if (T->isIntegerTy(1)) {
-                e = new z3::expr(c.bool_const(name.c_str()));
+                e = newExpr(c.bool_const(name.c_str()));
             } else {
-                e = new z3::expr(c.int_const(name.c_str()));
+                e = newExpr(c.int_const(name.c_str()));
             }
             break;
         }
         case Type::DoubleTyID:
         case Type::FloatTyID:
         case Type::HalfTyID: {
-            e = new z3::expr(c.real_const(name.c_str()));
+            e = newExpr(c.real_const(name.c_str()));
             break;
         }
         default: {
-            e = new z3::expr(c.bool_const(name.c_str()));
+            e = newExpr(c.bool_const(name.c_str()));
             break;
         }
     }
@@ -1191,16 +1420,15 @@ Instruction *TrafficRuleInfo::getUniqueDefinition(Path *P, MNode *N, Instruction
         return nullptr;
     }
     Instruction *def = nullptr;
-    auto VP = std::make_pair(I, V);
-    if (N->UDs.find(VP) != N->UDs.end()) {
-        auto defs = N->UDs[VP];
+    auto defs = N->getUDs(I, V);
+    if (defs.first != defs.second) {
         bool found = false;
         for (auto nit = P->nodes.rbegin(); nit != P->nodes.rend(); nit++) {
             MNode *M = (*nit);
             BasicBlock *BB = M->BB;
-            for (auto d : defs) {
-                if (d->getParent() == BB) {
-                    def = d;
+            for (auto d = defs.first; d != defs.second; d++) {
+                if (d->second->getParent() == BB) {
+                    def = d->second;
                     found = true;
                     break;
                 }
@@ -1,14 +1,17 @@
 #ifndef __TRAFFIC_RULE_INFO_H__
 #define __TRAFFIC_RULE_INFO_H__
 
+#include "callee-registry.h"
 #include "control-dependency.h"
 #include "utils.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Allocator.h"
 #include <llvm/Support/raw_ostream.h>
 
 // Option 1: use KLEE to directly perform module level symbolic execution
@@ -17,24 +20,68 @@
 // Option 2: Use z3 as our theorem solver to perform a simple symbolic execution
 #include "z3++.h"
 
+#include <list>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <sstream> 
 
 namespace llvm {
 
+/** Owns the z3 expressions of an analysis: they are allocated from a bump allocator and destroyed together by
+ * reset(), which has to run before their context goes away */
+class ExprArena {
+   public:
+    z3::expr *make(const z3::expr &e) {
+        return new (allocator.Allocate()) z3::expr(e);
+    }
+    void reset() {
+        allocator.DestroyAll();
+    }
+
+   private:
+    SpecificBumpPtrAllocator<z3::expr> allocator;
+};
+
+/** Decides path feasibility on one solver shared by all the paths of an analysis. Each distinct constraint is asserted
+ * once behind a fresh guard literal and checked as an assumption, so what the solver learns on a path (its common
+ * prefix with the siblings) is reused by the next checks; verdicts are cached by AST id. The guarded constraints are
+ * scoped by push / pop (one scope per analyzed function), so the solver does not keep those of finished functions.
+ * Has to be destroyed before its context, and the constraints it checked must outlive it (their ids are the cache keys). */
+class FeasibilityChecker {
+   public:
+    explicit FeasibilityChecker(z3::context &c) : c(c), solver(c) {}
+    bool feasible(const z3::expr &constraint);
+    void push() {
+        solver.push();
+    }
+    /** Drops the constraints asserted since the matching push; their cached verdicts stay valid */
+    void pop() {
+        solver.pop();
+    }
+
+   private:
+    z3::context &c;
+    z3::solver solver;
+    std::map<unsigned, bool> verdicts;
+};
+
 class VectorStatus {
   public:
     // vector analysis
     std::map<Value *, std::set<Value *>> vectorTaints;
     std::set<Value *> vectorSources;
     std::map<Value *, bool> vectorStatus;
+    // XOR of the hashes of the vectorStatus entries, kept up to date by setSource/setStatus
+    size_t statusHash = 0;
 
     VectorStatus() {}
     VectorStatus(VectorStatus const &other) {
         vectorTaints = other.vectorTaints;
         vectorSources = other.vectorSources;
         vectorStatus = other.vectorStatus;
+        statusHash = other.statusHash;
     }
 
     void setSources(std::set<Value *> vectors);
@@ -55,15 +102,18 @@ class Path {
     VectorStatus vectorStatus;
     // z3 expr has no default constructors...
     z3::expr *constraint;
+    // written through setVar only, which keeps varsHash up to date
     std::map<Instruction *, z3::expr *> vars;
+    // XOR of the hashes of the vars entries
+    size_t varsHash = 0;
     std::vector<MNode *> nodes;
     std::vector<BasicBlock *> blocks;
     Function *F;
     BasicBlock *next;
     unsigned int weight = 1;
 
-    Path(Function *F, z3::context &c) : F(F) {
-        constraint = new z3::expr(c.bool_val(true));
+    Path(Function *F, ExprArena &exprs, z3::context &c) : F(F) {
+        constraint = exprs.make(c.bool_val(true));
         next = &(F->getEntryBlock());
     }
 
@@ -73,16 +123,46 @@ class Path {
         nodes = other.nodes;
         blocks = other.blocks;
         vars = other.vars;
+        varsHash = other.varsHash;
         F = other.F;
         next = other.next;
         weight = other.weight;
     }
 
+    void setVar(Instruction *I, z3::expr *e) {
+        auto inserted = vars.insert(std::make_pair(I, e));
+        if (!inserted.second) {
+            varsHash ^= hash_combine(I, inserted.first->second);
+            inserted.first->second = e;
+        }
+        varsHash ^= hash_combine(I, e);
+    }
+
+    /** Hash of everything operator== compares: equal paths have equal hashes */
+    size_t hash() const {
+        return hash_combine(F, next, varsHash, vectorStatus.statusHash);
+    }
+
     bool operator==(const Path &other) {
         return F == other.F && next == other.next && vars == other.vars && vectorStatus == other.vectorStatus;
     }
 };
 
+/** What a target function contributes at its call sites, computed once per run with its formal arguments as symbolic
+ * variables; call sites instantiate it by substituting their actual arguments for the formals */
+struct CalleeSummary {
+    // variables of the formal arguments, in argument order (nullptr if an argument has none)
+    std::vector<z3::expr *> formals;
+    // return expression over the formals, or nullptr if the function returns nothing
+    z3::expr *ret = nullptr;
+    // number of paths (sum of their weights)
+    unsigned int pathCount = 0;
+};
+
+/** Live paths of a function bucketed by the block they wait on (Path::next), so extending a block only visits its
+ * own bucket; lists keep removal O(1) and let forked paths be spliced into their next bucket */
+typedef std::map<BasicBlock *, std::list<Path>> PathBuckets;
+
 class TrafficRuleInfo : public ModulePass {
    public:
     static char ID;
@@ -101,7 +181,6 @@ class TrafficRuleInfo : public ModulePass {
     std::vector<z3::expr *> globalConstraints;
     // func => value => z3 expr
     std::map<Value*, z3::expr*> hardcode;
-    std::set<std::string> apiFuncName;
 
     unsigned int path_cnt = 1;
 
@@ -111,6 +190,13 @@ class TrafficRuleInfo : public ModulePass {
 
     std::set<BasicBlock *> extendedBlocks;
 
+    // callee => summary, built on its first call
+    std::map<Function *, CalleeSummary> summaries;
+    // callee => caller => actual arguments of the caller's first call, which bind the callee's formals in the call chain constraints
+    std::map<Function *, std::map<Function *, std::vector<z3::expr *>>> callBindings;
+    // functions whose paths are being extracted (recursive calls to them are left opaque)
+    std::set<Function *> analyzing;
+
     static unsigned unnamedVarCnt;
 
     TrafficRuleInfo() : ModulePass(ID) {}
@@ -129,17 +215,36 @@ class TrafficRuleInfo : public ModulePass {
 
    private:
     void extractConstraint(ControlDependency &CD, z3::context &c);
+    z3::expr *getChainConstraint(Function *F, ControlDependency &CD, z3::context &c, std::map<Function *, z3::expr *> &chainConstraints, std::set<Function *> &visiting, const std::set<Function *> &cyclic);
+    void findCyclicFunctions(ControlDependency &CD, std::set<Function *> &cyclic);
 
-    void extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType> edges, MNode *N, ControlDependency &CD, z3::context &c);
+    void extendPaths(Function *F, BasicBlock *BB, std::set<EdgeType> edges, MNode *N, ControlDependency &CD, z3::context &c, PathBuckets &live, PathBuckets &forked);
     void finalizePaths(Function *F, ControlDependency &CD, z3::context &c);
     void printPaths(Function *F);
-    void mergePaths(Function *F);
-    void cleanPaths(Function *F, z3::context &c);
+    void mergePaths(std::list<Path> &paths);
+    void cleanPaths(std::list<Path> &paths);
+
+    const CalleeSummary *getCalleeSummary(Function *F, ControlDependency &CD, z3::context &c);
+    z3::expr *instantiate(Function *F, z3::expr *e, const std::vector<z3::expr *> &actuals, z3::context &c);
 
     void executeBlock(Path *P, MNode *N, ControlDependency &CD, z3::context &c);
     void executeBranch(Path *P, MNode *N, BasicBlock *next, ControlDependency &CD, z3::context &c);
     void executeInstruction(Path *P, MNode *N, Instruction *I, ControlDependency &CD, z3::context &c);
 
+    // every z3 expression of the analysis, released at the end of runOnModule
+    ExprArena exprs;
+    z3::expr *newExpr(const z3::expr &e) {
+        return exprs.make(e);
+    }
+    // AST id => simplified expression, for the inputs and the results of simplified()
+    std::map<unsigned, z3::expr *> simplifiedExprs;
+    /** e.simplify(), memoized by AST id: hash-consing gives equal expressions the same id */
+    z3::expr *simplified(const z3::expr &e);
+    // shared by the feasibility checks of all the paths, created per run
+    std::unique_ptr<FeasibilityChecker> feasibility;
+    /** Drops all the state holding expressions and frees them */
+    void releaseExprs();
+
     z3::expr *newZ3Const(Constant *C, z3::context &c);
     z3::expr *newZ3DefaultConst(Type *T, z3::context &c);
     z3::expr *newZ3Var(Value *V, ControlDependency &CD, z3::context &c);
@@ -154,98 +259,9 @@ class TrafficRuleInfo : public ModulePass {
     std::string getOpType(Value *I, std::string operand);
     Instruction *getUniqueDefinition(Path *P, MNode *N, Instruction *I, Value *V);
 
-    void getHardcodeMap(Module &M, ControlDependency &CD, z3::context &c) {
-        for (auto &gvar : M.getGlobalList()) {
-            if (gvar.getName() == "_ZN6apollo8planning12CreepDecider20creep_clear_counter_E") {
-                hardcode[&gvar] = new z3::expr(c.int_val(4));
-            }
-        }
-        for (Function *F : CD.TargetFuncPtrs) {
-            std::string funcName = demangle(F->getName().str().c_str());
-            if (funcName.find("apollo::planning::Crosswalk::MakeDecisions") != std::string::npos ) {
-                for (BasicBlock &BB : *F) {
-                    for (Instruction &I : BB) {
-                        if (isa<CallBase>(&I)) {
-                            Function* calledFunc = getCalledFunction(dyn_cast<CallBase>(&I));
-                            std::string calledFuncName = demangle(calledFunc->getName().str().c_str());
-                            if (calledFuncName.find("has_crosswalk_id") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(false));
-                            }
-                            if (calledFuncName.find("_ZSteqIcEN9__gnu_cxx11__enable_ifIXsr9__is_charIT_EE7__valueEbE6__typeERKSbIS2_St11char_traitsIS2_ESaIS2_EESA_") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(false));
-                            }
-                            if (calledFuncName.find("hypot") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.real_val(1));
-                            }
-                        }
-                    }
-                }
-            }
-            if (funcName.find("apollo::planning::TrafficLight::MakeDecisions") != std::string::npos ||
-                funcName.find("apollo::planning::StopSign::MakeDecisions") != std::string::npos) {
-                for (BasicBlock &BB : *F) {
-                    for (Instruction &I : BB) {
-                        if (isa<CallBase>(&I)) {
-                            Function* calledFunc = getCalledFunction(dyn_cast<CallBase>(&I));
-                            std::string calledFuncName = demangle(calledFunc->getName().str().c_str());
-                            if (calledFuncName.find("_ZSteqIcEN9__gnu_cxx11__enable_ifIXsr9__is_charIT_EE7__valueEbE6__typeERKSbIS2_St11char_traitsIS2_ESaIS2_EESA_") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(false));
-                            }
-                        }
-                    }
-                }
-            }
-            if (funcName.find("apollo::planning::Crosswalk::CheckStopForObstacle") != std::string::npos) {
-                for (BasicBlock &BB : *F) {
-                    for (Instruction &I : BB) {
-                        if (isa<CallBase>(&I)) {
-                            Function* calledFunc = getCalledFunction(dyn_cast<CallBase>(&I));
-                            std::string calledFuncName = demangle(calledFunc->getName().str().c_str());
-                            if (calledFuncName.find("apollo::perception::PerceptionObstacle::type") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.real_val(1));
-                            }
-                        }
-                    }
-                }
-            }
-            if (funcName.find("apollo::planning::scenario::stop_sign::StopSignUnprotectedStagePreStop::AddWatchVehicle") != std::string::npos ||
-                funcName.find("apollo::planning::scenario::stop_sign::StopSignUnprotectedStageStop::RemoveWatchVehicle") != std::string::npos) {
-                for (BasicBlock &BB : *F) {
-                    for (Instruction &I : BB) {
-                        if (isa<CallBase>(&I)) {
-                            Function* calledFunc = getCalledFunction(dyn_cast<CallBase>(&I));
-                            std::string calledFuncName = calledFunc->getName().str().c_str();
-                            if (calledFuncName.find("_ZN9__gnu_cxxeqIPSt4pairISt10shared_ptrIKN6apollo5hdmap8LaneInfoEES2_IKNS4_11OverlapInfoEEESt6vectorISB_SaISB_EEEEbRKNS_17__normal_iteratorIT_T0_EESL_") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(false));
-                            }
-                            if (calledFuncName.find("_ZSteqIKN6apollo5hdmap8LaneInfoEEbRKSt10shared_ptrIT_EDn") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(false));
-                            }
-                            if (calledFuncName.find("_ZN9__gnu_cxxeqIPSsSt6vectorISsSaISsEEEEbRKNS_17__normal_iteratorIT_T0_EESA_") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.bool_val(true));
-                            }
-                        }
-                    }
-                }
-            }
-            if (funcName.find("apollo::planning::SpeedDecider::MakeObjectDecision") != std::string::npos) {
-                for (BasicBlock &BB : *F) {
-                    for (Instruction &I : BB) {
-                        if (isa<CallBase>(&I)) {
-                            Function* calledFunc = getCalledFunction(dyn_cast<CallBase>(&I));
-                            if (calledFunc->getName().str().find("_ZNKSt6vectorIN6apollo6common10SpeedPointESaIS2_EE4sizeEv") != std::string::npos) {
-                                hardcode[&I] = new z3::expr(c.real_val(4));
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    void getApiFuncName() {
-        apiFuncName.insert("apollo::common::math::Polygon2d::IsPointIn(apollo::common::math::Vec2d const&) const");
-    }
+    /** Values forced on globals and on calls of the target functions, by the hardcode rules of the callee registry */
+    void initHardcode(Module &M, ControlDependency &CD, z3::context &c);
+    z3::expr *newHardcodeExpr(const HardcodeRule &rule, z3::context &c);
 };
 
 }  // namespace llvm
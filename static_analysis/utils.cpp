@@ -1,7 +1,11 @@
 #include "utils.h"
 #include <cxxabi.h>
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include "llvm/IR/Instructions.h"
 
 namespace llvm {
@@ -28,19 +32,6 @@ std::string get_func_name(const char *name){
     return pruned_str;
 }
 
-bool std_function(const char *name) {
-
-    std::string func_name = get_func_name(name);
-
-    if (func_name.find("apollo::") != std::string::npos) return false;
-    if (func_name.find("double") != std::string::npos) return false;
-    if (func_name.find("__gnu_cxx::") != std::string::npos) return true;
-    if (func_name.find("std::") != std::string::npos) return true;
-    if (func_name.find("verbose_level") != std::string::npos) return true;
-    if (func_name.find("Iterator") != std::string::npos) return true;
-    return false;
-}
-
 Value *valueToDefVar(Value *v) {
     if (isa<Argument>(v)) {
         return v;
@@ -105,14 +96,25 @@ std::string getTypeName(Value *V) {
     return temp_name;
 }
 
-bool isVectorType(Value *V) {
-    std::string typeName = getTypeName(V);
-    if (typeName.find("std::vector") != std::string::npos ||
-        typeName.find("google::protobuf::RepeatedPtrField") != std::string::npos) {
-        return true;
-    } else {
-        return false;
+void parallelForEach(unsigned numThreads, size_t count, const std::function<void(size_t)> &body) {
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min<size_t>(numThreads, count);
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < count; i++)
+            body(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < numThreads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < count; i = next++)
+                body(i);
+        }));
     }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
 }
 
-}  // namespace llvm
\ No newline at end of file
+}  // namespace llvm
@@ -1,6 +1,7 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <functional>
 #include <string>
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Value.h"
@@ -13,8 +14,6 @@ std::string demangle(const char *name);
 
 std::string get_func_name(const char *name);
 
-bool std_function(const char *name);
-
 Value* valueToDefVar(Value* v);
 
 std::string typeToStr(Type* t);
@@ -25,7 +24,8 @@ Function *getCalledFunction(CallBase *call);
 
 std::string getTypeName(Value *V);
 
-bool isVectorType(Value *V);
+/** Calls body(i) for every i in [0, count) on up to numThreads threads (0 uses one per hardware thread) */
+void parallelForEach(unsigned numThreads, size_t count, const std::function<void(size_t)> &body);
 
 }  // namespace llvm
 